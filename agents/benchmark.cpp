@@ -0,0 +1,167 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "clan.hpp"
+using namespace al;
+using namespace std;
+
+//headless flocking benchmark, how the boid step scales with threads
+//no window, no audio, no cuttlebone: seeds a Clan and targets
+//deterministically, runs the same steps once per thread count and prints
+//ms/step, speedup over one thread, and a checksum of the final flock,
+//which must be the same on every row of a size.
+//
+//build it like the other agents apps, e.g.
+//  c++ -O3 -march=native -std=c++11 -pthread benchmark.cpp -lallocore -o benchmark
+//
+//usage: benchmark [--steps 20] [--counts 1000,10000,50000] [--threads 1,2,4,8]
+//                 [--targets 3] [--radius 200] [--seed 1] [--csv]
+//
+//--threads defaults to 1, 2, 4 .. up to the number of cores.
+//boids are spread through a ball of --radius, the app spawns them in 50.
+
+struct BenchConfig{
+    unsigned steps;
+    vector<unsigned> counts;
+    vector<unsigned> threads;
+    unsigned targets;
+    float radius;
+    unsigned seed;
+    bool csv;
+
+    BenchConfig(){
+        steps = 20;
+        unsigned defaultCounts[] = { 1000, 10000, 50000 };
+        counts.assign(defaultCounts, defaultCounts + 3);
+        unsigned cores = thread::hardware_concurrency();
+        for (unsigned t = 1; t < cores; t *= 2) threads.push_back(t);
+        threads.push_back(cores > 0 ? cores : 1);
+        targets = 3;
+        radius = 200;
+        seed = 1;
+        csv = false;
+    }
+};
+
+vector<string> split(const string& s){
+    vector<string> parts;
+    size_t start = 0;
+    while (start <= s.size()){
+        size_t comma = s.find(',', start);
+        if (comma == string::npos) comma = s.size();
+        if (comma > start) parts.push_back(s.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return parts;
+}
+
+Vec3f inBall(mt19937& gen, float radius){
+    uniform_real_distribution<float> uniformS(-1, 1);
+    Vec3f p;
+    do {
+        p = Vec3f(uniformS(gen), uniformS(gen), uniformS(gen));
+    } while (p.mag() > 1);
+    return p * radius;
+}
+
+void seed(Clan& clan, Target_group& tg, const BenchConfig& config, unsigned count){
+    mt19937 gen(config.seed);
+    clan.boids.clear();
+    clan.boids.reserve(count);
+    for (unsigned i = 0; i < count; ++i){
+        clan.grow();
+        Boid& b = clan.boids.back();
+        b.pose.pos() = inBall(gen, config.radius);
+        b.velocity = inBall(gen, b.maxspeed);
+    }
+    //the flow field drifts with every build, start each run from the same one
+    clan.flow.time = 0;
+    clan.flow.resize(boundary_radius, flowResolution);
+    tg.targets.clear();
+    for (unsigned i = 0; i < config.targets; ++i){
+        tg.add_target();
+        Target& t = tg.targets.back();
+        t.position = inBall(gen, config.radius);
+        t.velocity = Vec3f(0, 1, 0).cross(t.position).normalize(t.initialSpeed);
+    }
+    //the grid was built where add_target() put them
+    tg.rebuild();
+}
+
+//fnv-1a over the bits of every position and velocity
+uint64_t checksum(const Clan& clan){
+    uint64_t h = 14695981039346656037ull;
+    for (const Boid& b : clan.boids){
+        float v[6] = { (float)b.pose.pos()[0], (float)b.pose.pos()[1], (float)b.pose.pos()[2],
+                       b.velocity[0], b.velocity[1], b.velocity[2] };
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(v);
+        for (unsigned k = 0; k < sizeof(v); ++k){
+            h = (h ^ bytes[k]) * 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+int main(int argc, char* argv[]){
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--steps" && hasValue){
+            config.steps = atoi(argv[++i]);
+        } else if (arg == "--counts" && hasValue){
+            config.counts.clear();
+            for (string c : split(argv[++i])) config.counts.push_back(atoi(c.c_str()));
+        } else if (arg == "--threads" && hasValue){
+            config.threads.clear();
+            for (string t : split(argv[++i])) config.threads.push_back(atoi(t.c_str()));
+        } else if (arg == "--targets" && hasValue){
+            config.targets = atoi(argv[++i]);
+        } else if (arg == "--radius" && hasValue){
+            config.radius = atof(argv[++i]);
+        } else if (arg == "--seed" && hasValue){
+            config.seed = atoi(argv[++i]);
+        } else if (arg == "--csv"){
+            config.csv = true;
+        } else {
+            fprintf(stderr, "unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (config.csv){
+        printf("boids,threads,ms_per_step,speedup,checksum\n");
+    } else {
+        printf("%u steps, %u targets, radius %g, seed %u\n", config.steps, config.targets, config.radius, config.seed);
+        printf("%9s %7s %11s %8s %18s\n", "boids", "threads", "ms/step", "speedup", "checksum");
+    }
+    Clan clan;
+    Target_group tg;
+    for (unsigned count : config.counts){
+        double first = 0;
+        for (unsigned threads : config.threads){
+            clan.threads(threads);
+            clan.framesSinceSort = 0;
+            seed(clan, tg, config, count);
+            chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+            for (unsigned s = 0; s < config.steps; ++s){
+                clan.run(tg);
+                tg.applyBehaviors();
+            }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / config.steps;
+            if (first == 0) first = ms;
+            if (config.csv){
+                printf("%u,%u,%.4f,%.3f,%016llx\n", count, clan.threads(), ms, first / ms, (unsigned long long)checksum(clan));
+            } else {
+                printf("%9u %7u %11.3f %8.2f %18llx\n", count, clan.threads(), ms, first / ms, (unsigned long long)checksum(clan));
+            }
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,495 @@
+#ifndef INCLUDE_CLAN_HPP
+#define INCLUDE_CLAN_HPP
+
+#include "allocore/io/al_App.hpp"
+#include "allocore/math/al_Quat.hpp"
+#include "allocore/spatial/al_Pose.hpp"
+#include "../gravity/morton_order.hpp"
+#include "../gravity/thread_pool.hpp"
+#include "../gravity/spatial_grid.hpp"
+#include "flock.hpp"
+#include "flow_field.hpp"
+using namespace al;
+using namespace std;
+
+//boids and targets without the app, shared by simulator.cpp and benchmark.cpp
+
+double scaleFactor = 0.1;  
+double coneRadius = 3;
+double coneHeight = coneRadius * 3;
+double sphereRadius = 3;
+double boundary_radius = 200; //a spherical boundary with center at (0,0,0)
+Vec3f boundary_origin(0,0,0); //boundary center as (0,0,0)
+int clan_population_max = 50; //max boids in the scene
+unsigned sortInterval = 32; //frames between morton re-sorts of the boids, 0 never
+float flowResolution = 10; //flow field node spacing
+double flowWeight = 0.5; //how hard boids follow the flow field, 0 off
+Mesh cone;
+Mesh sphere;
+
+// helper function: makes a random vector
+Vec3f r() { return Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()); }
+//map function
+float MapValue(float x, float in_min, float in_max, float out_min, float out_max){
+  return (x - in_min) * (out_max  - out_min) / (in_max - in_min) + out_min;
+}
+
+struct Frame : Mesh {
+        double length = 6;
+        Frame(){
+            primitive(Graphics::LINES);
+            //x axis
+            vertex(0, 0, 0);
+            color(1,1,1);
+            vertex(length, 0, 0);
+            color(1, 0, 0);
+
+            //y axis
+            vertex(0, 0, 0);
+            color(1,1,1);
+            vertex(0, length, 0);
+            color(0, 1, 0);
+
+            //z axis
+            vertex(0, 0, 0);
+            color(1,1,1);
+            vertex(0, 0, length);
+            color(0, 0, 1);
+        }
+};
+
+struct Target{
+    Vec3f position, velocity, acceleration;
+    float lifespan;
+    Color c;
+    float initialRadius;
+    float initialSpeed;
+    float mass;
+    float maximumAcceleration;
+    float lifeDecaySpeed;
+    Target(){
+        initialRadius = 60;
+        initialSpeed = 2.5;
+        position = r() * initialRadius;
+        mass = 1;
+        maximumAcceleration = 30;
+        lifeDecaySpeed = 0.0001;
+        velocity = Vec3f(0, 1, 0).cross(position).normalize(initialSpeed);
+    c = HSV(rnd::uniform(), 0.7, 1);
+    lifespan = rnd::uniform() * 1.0;
+    }
+    void applyForce(){
+      Vec3f f = acceleration / mass;
+      acceleration += f;
+      if (acceleration.mag() > maximumAcceleration){
+        acceleration.normalize(maximumAcceleration);
+      }
+      acceleration.zero();
+      //velocity += spring_force; //collision spring effect
+    }
+    void update(){
+      velocity += acceleration;
+      position += velocity;
+      lifespan -= lifeDecaySpeed;
+    }
+    void boundary_detect(){
+      Vec3f d = position - boundary_origin;
+      if (d > boundary_radius) {
+          velocity *= -1;
+      }
+    }
+    void draw(Graphics& g) {
+    g.pushMatrix();
+    g.translate(position);
+    g.color(c);
+    g.draw(sphere);
+    g.popMatrix();
+    }
+     bool isDead(){
+      if (lifespan < 0.0){
+          return true;
+      } else {
+          return false;
+      }
+  }
+};
+
+struct Target_group{
+    vector<Target> targets;
+    SpatialGrid grid; //over target positions, rebuilt whenever they move or die
+    float cellSize;   //widest radius nearest() answers from the grid
+
+    Target_group(){
+        cellSize = 90;
+    }
+    void add_target(){
+        Target t;
+        targets.push_back(t);
+        rebuild();
+    }
+    void applyBehaviors(){
+        for (Target& t : targets) {
+            t.applyForce();
+            t.boundary_detect();
+            t.update();
+        }
+        rebuild();
+    }
+    void rebuild(){
+        grid.build(targets, cellSize);
+    }
+    //index of the closest target within radius of p, -1 if none
+    //ties go to the lower index, like a scan in order would
+    int nearest(const Vec3f& p, float radius) const {
+        int best = -1;
+        float bestDistance = radius;
+        auto visit = [&](unsigned j){
+            float d = (p - targets[j].position).mag();
+            if (d <= 0) return;
+            if (d < bestDistance || (d == bestDistance && best >= 0 && (int)j < best)){
+                best = j;
+                bestDistance = d;
+            }
+        };
+        if (radius <= cellSize){
+            grid.neighbours(p, visit);
+        } else {
+            for (unsigned j = 0; j < targets.size(); ++j) visit(j);
+        }
+        return best;
+    }
+    void draw(Graphics& g){
+        bool died = false;
+        for (int i = targets.size() - 1; i >= 0; i--){
+            Target& t = targets[i];
+            t.draw(g);
+            if (t.isDead()){
+                targets.erase(targets.begin() + i);
+                died = true;
+            }
+        }
+        if (died) rebuild();
+    }
+};
+
+struct Boid {
+    Vec3f velocity, acceleration;
+    Pose pose;
+    float maxspeed;
+    float maxAcceleration;
+    float mass;
+    float maxforce;
+    float initialRadius; // spawn area
+    float neighbour_senseRadius;
+    float target_senseRadius;
+    float desiredseparation;
+    Color c;
+    Quatd q;
+    Frame fm;
+    Mesh sphere;
+
+    Boid(){
+        maxAcceleration = 30;
+        mass = 1.0;
+        maxspeed = 4;
+        maxforce = 0.1;
+        initialRadius = 50;
+        neighbour_senseRadius = 30;
+        target_senseRadius = 90;
+        desiredseparation = 20;
+
+        acceleration = Vec3f(0,0,0);
+        velocity = Vec3f(0,0,0);
+        pose.pos() = r() * initialRadius;
+        c = HSV(rnd::uniform(), 0.7, 1);
+    }
+    
+    Vec3f seek(Vec3f target){
+        Vec3f desired = target - pose.pos();
+        desired.normalized();
+        desired *= maxspeed;
+        Vec3f steer = desired - velocity;
+        if (steer.mag() > maxforce){
+            steer.normalize(maxforce);
+        }
+        return steer;
+    }
+
+    Vec3f arrive(Vec3f target){
+        Vec3f desired = target - pose.pos();
+        float d = desired.mag();
+        desired.normalize();
+        if (d < target_senseRadius){
+            float m = MapValue(d, 0, target_senseRadius, 0, maxspeed);
+            desired *= m;
+        } else {
+            desired *= maxspeed;
+        }
+        Vec3f steer = desired - velocity;
+        if (steer.mag() > maxforce){
+            steer.normalize(maxforce);
+        }
+        return steer;
+    }
+
+    //steer along the flow field where the boid is, one lookup
+    Vec3f follow(const FlowField& field){
+        Vec3f desired = field.sample(pose.pos()) * maxspeed;
+        Vec3f steer = desired - velocity;
+        if (steer.mag() > maxforce){
+            steer.normalize(maxforce);
+        }
+        return steer;
+    }
+
+    void update(){
+        velocity += acceleration;
+        if (velocity.mag() > maxspeed){
+            velocity.normalize(maxspeed);
+        }
+        pose.pos() += velocity;
+        acceleration *= 0; //zeros acceleration
+    }
+
+    //not used, only for special single target
+    Quatd facing_single_target(Vec3f t){
+        Quatd q;
+        Vec3f src = Vec3f(pose.quat().toVectorZ()).normalize(); //initial
+        Vec3f dst = Vec3f(t - pose.pos()).normalize(); //destination
+        Vec3f desired = t - pose.pos();
+        float d = desired.mag();
+        Quatd rot = Quatd::getRotationTo(src,dst);
+        return q;
+    }
+    void find_direction(const Neighbourhood& n, const Target_group& tg){
+        Vec3f sum(0,0,0);
+
+        //find closest target within reach
+        int min_id = tg.nearest(pose.pos(), target_senseRadius);
+
+        //find center of clan position
+        if (n.friends > 0){
+            sum = n.center / n.friends;
+            sum = sum + velocity * 10; 
+            //position + velocity = temporary target to look at
+        } 
+
+        //once find target nearby, arrive and follow it
+        if (min_id >= 0){
+            Vec3f ar(arrive(tg.targets[min_id].position));
+            ar *= 1.0;
+            applyForce(ar);
+            Vec3f src = Vec3f(pose.quat().toVectorZ()).normalize();
+            Vec3f dst = Vec3f(tg.targets[min_id].position - pose.pos()).normalize();
+            Quatd rot = Quatd::getRotationTo(src,dst);
+            pose.quat() =  rot * pose.quat();      
+        } else {
+            //if no target nearby, look at where clan is moving to
+            Vec3f src = Vec3f(pose.quat().toVectorZ()).normalize();
+            Vec3f dst = Vec3f(sum - pose.pos()).normalize();
+            Quatd rot = Quatd::getRotationTo(src,dst);
+            pose.quat() =  rot * pose.quat();
+        }
+    }
+
+    void applyForce(Vec3f force){
+      Vec3f f = force / mass;
+      acceleration += f;
+      if (acceleration.mag() > maxAcceleration){
+        acceleration.normalize(maxAcceleration);
+      }
+    }
+
+    //the steering rules read what FlockIndex::query found around this boid
+    Vec3f separate(const Neighbourhood& n){
+        if (n.close > 0){
+            Vec3f sum = n.away / n.close;
+            sum.mag(maxspeed);
+            Vec3f steer = sum - velocity;
+            if (steer.mag() > maxforce) {
+                steer.normalize(maxforce);
+            }
+            return steer;
+        } else {
+            return Vec3f(0,0,0);
+        }
+    }
+    Vec3f alignment(const Neighbourhood& n){
+        if (n.friends > 0){
+            Vec3f sum = n.velocity / n.friends;
+            sum.mag(maxspeed);
+            Vec3f steer = sum - velocity;
+            if (steer.mag() > maxforce) {
+                steer.normalize(maxforce);
+            }
+            return steer;
+        } else {
+            return Vec3f(0,0,0);
+        }
+    }
+
+    Vec3f cohesion(const Neighbourhood& n){
+        if (n.friends > 0){
+            return seek(n.center / n.friends);
+        } else {
+            return Vec3f(0,0,0);
+        }
+    }
+
+    void flock(const Neighbourhood& n){
+        Vec3f sep(separate(n));
+        Vec3f ali(alignment(n));
+        Vec3f coh(cohesion(n));
+        Vec3f bd(border_detect());
+        sep *= 2.0;
+        ali *= 1.0;
+        coh *= 1.0;
+        bd *= 1.5;
+        applyForce(sep);
+        applyForce(ali);
+        applyForce(coh);
+        applyForce(bd);
+    }
+
+    //some sort of gravitational force from the center, also constant base force
+    void seekCenter(){
+        Vec3f center(0,0,0);
+        Vec3f sk(seek(center));
+            sk *= 0.3;
+            applyForce(sk);
+    }
+
+    //turn around when border reached
+    Vec3f border_detect(){
+        Vec3f origin(0,0,0);
+        Vec3f distance = pose.pos() - origin;
+        if (distance.mag() > boundary_radius) {
+            Vec3f desired = origin - pose.pos();
+            Vec3f steer = desired - velocity;
+            if (steer.mag() > maxforce) {
+                steer.normalize(maxforce);
+            }
+            return steer;
+        } else {
+            return Vec3f(0,0,0);
+        }
+    }
+
+    void draw(Graphics& g) {
+        g.pushMatrix();
+        g.translate(pose.pos());
+        //g.rotate(facing_single_target(Vec3f(0,0,0)));
+        g.rotate(pose.quat());
+        g.color(c);
+        g.draw(cone);
+        g.draw(fm);
+        g.popMatrix();
+    }
+};
+
+//the flock is double buffered: index holds the previous frame (positions
+//and velocities copied out once per step) and is only read, boids are the
+//next frame and each boid only writes itself. so boids can be stepped in
+//any order on any number of threads and come out bitwise the same.
+struct Clan {
+    vector<Boid> boids;
+    FlockIndex index; //neighbours of every boid, one build per step
+    MortonOrder morton; //after a sort, morton.rank[old index] is the new index
+    unsigned framesSinceSort;
+    ThreadPool pool;
+    FlowField flow; //rebuilt a few planes per step
+    FlockStats stats; //of the last step
+    vector<FlockStats> chunkStats;
+    enum { chunk = 64 }; //boids per work item, dealt round robin to threads
+
+    Clan(){
+        framesSinceSort = 0;
+        pool.resize(thread::hardware_concurrency());
+        flow.resize(boundary_radius, flowResolution);
+    }
+
+    const Boid& operator [](const int index) const {
+        return boids[index];
+    }
+    const vector<Boid>& operator ()() const{
+        return boids;
+    }
+
+    void threads(unsigned n){
+        pool.resize(n);
+    }
+    unsigned threads() const {
+        return pool.size();
+    }
+
+    void grow(){
+        Boid b;
+        boids.push_back(b);
+    }
+    void draw(Graphics& g){
+        for (int i = boids.size() - 1; i >= 0; i--){
+            Boid& b = boids[i];
+            b.draw(g);
+        }
+    }
+    //z-order the boids so flock neighbours sit close in memory
+    //the State is refilled in boid order every frame, so it follows along
+    void sort(){
+        morton.sort(boids.size(), [&](unsigned i){ return Vec3f(boids[i].pose.pos()); }, &pool);
+        morton.apply(boids);
+        framesSinceSort = 0;
+    }
+    void run(const Target_group& tg){
+        if (sortInterval > 0 && ++framesSinceSort >= sortInterval){
+            sort();
+        }
+        //everyone steers against where the flock was at the start of the step
+        index.build(boids, boidSenseRadius());
+        flow.update();
+        unsigned n = pool.size();
+        unsigned count = boids.size();
+        unsigned chunks = (count + chunk - 1) / chunk;
+        chunkStats.resize(chunks);
+        pool.run([&](unsigned t){
+            for (unsigned w = t; w < chunks; w += n){
+                unsigned end = (w + 1) * chunk < count ? (w + 1) * chunk : count;
+                chunkStats[w].clear();
+                for (unsigned i = w * chunk; i < end; ++i){
+                    step(i, tg, chunkStats[w]);
+                }
+            }
+        });
+        stats.clear();
+        for (FlockStats& s : chunkStats){
+            stats.merge(s);
+        }
+    }
+    void step(unsigned i, const Target_group& tg, FlockStats& s){
+        Boid& b = boids[i];
+        b.update();
+        Neighbourhood n = index.query(i, b.pose.pos(), b.neighbour_senseRadius, b.desiredseparation);
+        s.add(b.velocity.mag(), n.friends);
+        b.flock(n);
+        b.seekCenter();
+        if (flowWeight > 0){
+            b.applyForce(b.follow(flow) * flowWeight);
+        }
+        b.find_direction(n, tg);
+    }
+    float boidSenseRadius(){
+        float radius = 1;
+        for (Boid& b : boids){
+            if (b.neighbour_senseRadius > radius) radius = b.neighbour_senseRadius;
+        }
+        return radius;
+    }
+    //both read from the stats of the last step, no pass over the boids
+    double average_velocity(){
+        return stats.meanSpeed();
+    }
+    int solitude_level(){
+        return stats.totalFriends();
+    }
+};
+
+#endif
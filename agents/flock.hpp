@@ -0,0 +1,152 @@
+#ifndef INCLUDE_FLOCK_HPP
+#define INCLUDE_FLOCK_HPP
+
+#include <vector>
+#include <algorithm>
+#include "allocore/io/al_App.hpp"
+#include "../gravity/spatial_grid.hpp"
+
+using namespace al;
+using namespace std;
+
+//what one boid sees of the rest of the flock
+//separation, alignment, cohesion and the friend count all come out of the
+//same walk over the cells around the boid.
+struct Neighbourhood{
+    Vec3f away;         //sum of unit vectors away from boids closer than separation
+    int close;          //how many of those
+    Vec3f velocity;     //sum of friends' velocities
+    Vec3f center;       //sum of friends' positions
+    int friends;        //boids within the sense radius
+
+    Neighbourhood(){
+        away = Vec3f(0,0,0);
+        close = 0;
+        velocity = Vec3f(0,0,0);
+        center = Vec3f(0,0,0);
+        friends = 0;
+    }
+};
+
+//running statistics of the flock, filled in during the flock step
+//each chunk of boids sums into its own copy and the copies are merged in
+//chunk order, so the numbers do not depend on the thread count either.
+//exporting another metric means adding a field here, not another pass.
+struct FlockStats{
+    enum { BINS = 12 };
+    unsigned count;
+    double speedSum, speedSquares;
+    double friendSum, friendSquares;
+    unsigned histogram[BINS];   //boids by friends: 0, 1, 2-3, 4-7 ... 1024 or more
+
+    FlockStats(){
+        clear();
+    }
+    void clear(){
+        count = 0;
+        speedSum = speedSquares = 0;
+        friendSum = friendSquares = 0;
+        for (unsigned b = 0; b < BINS; ++b) histogram[b] = 0;
+    }
+    static unsigned bin(unsigned friends){
+        unsigned b = 0;
+        while (friends > 0 && b < BINS - 1){
+            friends >>= 1;
+            b ++;
+        }
+        return b;
+    }
+    void add(float speed, unsigned friends){
+        count ++;
+        speedSum += speed;
+        speedSquares += speed * speed;
+        friendSum += friends;
+        friendSquares += (double)friends * friends;
+        histogram[bin(friends)] ++;
+    }
+    void merge(const FlockStats& other){
+        count += other.count;
+        speedSum += other.speedSum;
+        speedSquares += other.speedSquares;
+        friendSum += other.friendSum;
+        friendSquares += other.friendSquares;
+        for (unsigned b = 0; b < BINS; ++b) histogram[b] += other.histogram[b];
+    }
+
+    double meanSpeed() const {
+        return count > 0 ? speedSum / count : 0;
+    }
+    double speedVariance() const {
+        if (count == 0) return 0;
+        double mean = meanSpeed();
+        return max(speedSquares / count - mean * mean, 0.0);
+    }
+    double meanFriends() const {
+        return count > 0 ? friendSum / count : 0;
+    }
+    double friendVariance() const {
+        if (count == 0) return 0;
+        double mean = meanFriends();
+        return max(friendSquares / count - mean * mean, 0.0);
+    }
+    //sum of every boid's friend count
+    unsigned totalFriends() const {
+        return (unsigned)friendSum;
+    }
+};
+
+//cell list over a snapshot of the flock, rebuilt once per step
+//cells are as wide as the sense radius, so every friend is in the 27
+//cells around a boid. positions and velocities are copied out of the
+//boids into packed arrays in cell order, so the query walks a few short
+//contiguous runs and never touches a Boid.
+struct FlockIndex{
+    SpatialGrid grid;
+    vector<Vec3f> position;     //by boid
+    vector<Vec3f> cellPosition; //by grid.sorted
+    vector<Vec3f> cellVelocity;
+
+    //anything with .pose and .velocity works as a boid
+    template <typename Boid>
+    void build(const vector<Boid>& boids, float senseRadius){
+        unsigned n = boids.size();
+        position.resize(n);
+        for (unsigned i = 0; i < n; ++i){
+            position[i] = boids[i].pose.pos();
+        }
+        grid.build(n, [&](unsigned i) -> const Vec3f& { return position[i]; }, senseRadius);
+        cellPosition.resize(n);
+        cellVelocity.resize(n);
+        for (unsigned k = 0; k < n; ++k){
+            cellPosition[k] = position[grid.sorted[k]];
+            cellVelocity[k] = boids[grid.sorted[k]].velocity;
+        }
+    }
+
+    //the neighbours of boid self around p, self left out wherever it was
+    //when the index was built. senseRadius must not be wider than the one
+    //the index was built with, and separation not wider than senseRadius
+    Neighbourhood query(unsigned self, const Vec3f& p, float senseRadius, float separation) const {
+        Neighbourhood n;
+        float sense2 = senseRadius * senseRadius;
+        float separation2 = separation * separation;
+        grid.cells(p, [&](unsigned begin, unsigned end){
+            for (unsigned k = begin; k < end; ++k){
+                if (grid.sorted[k] == self) continue;
+                Vec3f difference = p - cellPosition[k];
+                float d2 = difference.magSqr();
+                if (d2 <= 0 || d2 >= sense2) continue;
+                n.velocity += cellVelocity[k];
+                n.center += cellPosition[k];
+                n.friends ++;
+                if (d2 < separation2){
+                    n.away += difference / sqrtf(d2);
+                    n.close ++;
+                }
+            }
+        });
+        return n;
+    }
+};
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef INCLUDE_FLOW_FIELD_HPP
+#define INCLUDE_FLOW_FIELD_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include "allocore/io/al_App.hpp"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+using namespace al;
+using namespace std;
+
+//3d grid of unit steering vectors, sampled in O(1) per boid
+//nodes are spacing apart over [-extent, extent]^3, stored flat as x y z 0,
+//16 bytes each in one 64 byte aligned block, so a node is one simd load and
+//a sample is 8 loads and 7 lerps. the vectors come from smooth value noise
+//that drifts in time. the next field is built a few planes per frame into
+//a back buffer and swapped in when complete; boids always see a whole field.
+
+struct FlowField{
+    unsigned n;             //nodes a side
+    float extent;
+    float spacing;
+    float scale;            //noise features per unit length
+    float time;             //noise offset of the field being built
+    float drift;            //noise time between fields
+    unsigned rebuildFrames; //frames to build the next field over
+    unsigned nextPlane;     //first z plane of the back buffer still to build
+    float* front;           //sampled
+    float* back;            //being built
+
+    FlowField(){
+        n = 0;
+        extent = 1;
+        spacing = 1;
+        scale = 0.02;
+        time = 0;
+        drift = 0.3;
+        rebuildFrames = 30;
+        nextPlane = 0;
+        front = back = 0;
+    }
+    ~FlowField(){
+        free(front);
+        free(back);
+    }
+    //owns raw arrays, keep it out of copies
+    FlowField(const FlowField&) = delete;
+    FlowField& operator=(const FlowField&) = delete;
+
+    static float* alignedNodes(unsigned nodes){
+        void* p = 0;
+        if (posix_memalign(&p, 64, nodes * 4 * sizeof(float)) != 0) return 0;
+        return (float*)p;
+    }
+
+    //covers a ball of radius, one node every resolution units
+    void resize(float radius, float resolution){
+        free(front);
+        free(back);
+        extent = radius;
+        n = (unsigned)ceilf(2 * radius / resolution) + 1;
+        if (n < 2) n = 2;
+        spacing = 2 * extent / (n - 1);
+        front = alignedNodes(n * n * n);
+        back = alignedNodes(n * n * n);
+        build(front, 0, n, time);
+        time += drift;
+        nextPlane = 0;
+    }
+
+    //a few more planes of the next field, swapped in once all are done
+    void update(){
+        if (n == 0) return;
+        unsigned frames = max(rebuildFrames, 1u);
+        unsigned planes = (n + frames - 1) / frames;
+        unsigned end = min(nextPlane + planes, n);
+        build(back, nextPlane, end, time);
+        nextPlane = end;
+        if (nextPlane == n){
+            swap(front, back);
+            time += drift;
+            nextPlane = 0;
+        }
+    }
+
+    void build(float* nodes, unsigned z0, unsigned z1, float t) const {
+        for (unsigned z = z0; z < z1; ++z){
+            for (unsigned y = 0; y < n; ++y){
+                for (unsigned x = 0; x < n; ++x){
+                    float px = (x * spacing - extent) * scale;
+                    float py = (y * spacing - extent) * scale;
+                    float pz = (z * spacing - extent) * scale;
+                    //two independent noises pick a direction on the sphere
+                    float theta = noise(px, py, pz + t) * 2 * M_PI;
+                    float cosPhi = noise(px + 31.4f, py - 17.7f, pz + t) * 2 - 1;
+                    float sinPhi = sqrtf(1 - cosPhi * cosPhi);
+                    float* v = nodes + ((z * n + y) * n + x) * 4;
+                    v[0] = sinPhi * cosf(theta);
+                    v[1] = sinPhi * sinf(theta);
+                    v[2] = cosPhi;
+                    v[3] = 0;
+                }
+            }
+        }
+    }
+
+    //smooth value noise in [0, 1], hashed lattice with smoothstep blending
+    static float lattice(int x, int y, int z){
+        uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ (uint32_t)z * 83492791u;
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return (h & 0xffffff) / 16777215.0f;
+    }
+    static float noise(float x, float y, float z){
+        float fx = floorf(x), fy = floorf(y), fz = floorf(z);
+        int ix = (int)fx, iy = (int)fy, iz = (int)fz;
+        float u = x - fx, v = y - fy, w = z - fz;
+        u = u * u * (3 - 2 * u);
+        v = v * v * (3 - 2 * v);
+        w = w * w * (3 - 2 * w);
+        float c[2][2];
+        for (int dz = 0; dz < 2; ++dz){
+            for (int dy = 0; dy < 2; ++dy){
+                float a = lattice(ix, iy + dy, iz + dz);
+                float b = lattice(ix + 1, iy + dy, iz + dz);
+                c[dz][dy] = a + (b - a) * u;
+            }
+        }
+        float c0 = c[0][0] + (c[0][1] - c[0][0]) * v;
+        float c1 = c[1][0] + (c[1][1] - c[1][0]) * v;
+        return c0 + (c1 - c0) * w;
+    }
+
+    //trilinear sample of the front field, clamped to the grid
+    Vec3f sample(const Vec3f& p) const {
+        if (n == 0) return Vec3f(0,0,0);
+        unsigned i[3];
+        float f[3];
+        for (unsigned a = 0; a < 3; ++a){
+            float u = (p[a] + extent) / spacing;
+            if (u < 0) u = 0;
+            if (u > n - 1) u = n - 1;
+            unsigned lower = (unsigned)u;
+            if (lower > n - 2) lower = n - 2;
+            i[a] = lower;
+            f[a] = u - lower;
+        }
+        const float* c = front + ((i[2] * n + i[1]) * n + i[0]) * 4;
+        unsigned dy = n * 4, dz = n * n * 4;
+#if defined(__SSE__) || defined(_M_X64)
+        __m128 fx = _mm_set1_ps(f[0]), fy = _mm_set1_ps(f[1]), fz = _mm_set1_ps(f[2]);
+        __m128 c00 = _mm_load_ps(c), c01 = _mm_load_ps(c + 4);
+        __m128 c10 = _mm_load_ps(c + dy), c11 = _mm_load_ps(c + dy + 4);
+        __m128 c20 = _mm_load_ps(c + dz), c21 = _mm_load_ps(c + dz + 4);
+        __m128 c30 = _mm_load_ps(c + dz + dy), c31 = _mm_load_ps(c + dz + dy + 4);
+        __m128 x0 = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c01, c00), fx));
+        __m128 x1 = _mm_add_ps(c10, _mm_mul_ps(_mm_sub_ps(c11, c10), fx));
+        __m128 x2 = _mm_add_ps(c20, _mm_mul_ps(_mm_sub_ps(c21, c20), fx));
+        __m128 x3 = _mm_add_ps(c30, _mm_mul_ps(_mm_sub_ps(c31, c30), fx));
+        __m128 y0 = _mm_add_ps(x0, _mm_mul_ps(_mm_sub_ps(x1, x0), fy));
+        __m128 y1 = _mm_add_ps(x2, _mm_mul_ps(_mm_sub_ps(x3, x2), fy));
+        __m128 r = _mm_add_ps(y0, _mm_mul_ps(_mm_sub_ps(y1, y0), fz));
+        float out[4];
+        _mm_storeu_ps(out, r);
+        return Vec3f(out[0], out[1], out[2]);
+#else
+        Vec3f out;
+        for (unsigned a = 0; a < 3; ++a){
+            float x0 = c[a] + (c[4 + a] - c[a]) * f[0];
+            float x1 = c[dy + a] + (c[dy + 4 + a] - c[dy + a]) * f[0];
+            float x2 = c[dz + a] + (c[dz + 4 + a] - c[dz + a]) * f[0];
+            float x3 = c[dz + dy + a] + (c[dz + dy + 4 + a] - c[dz + dy + a]) * f[0];
+            float y0 = x0 + (x1 - x0) * f[1];
+            float y1 = x2 + (x3 - x2) * f[1];
+            out[a] = y0 + (y1 - y0) * f[2];
+        }
+        return out;
+#endif
+    }
+};
+
+#endif
@@ -2,71 +2,61 @@
 #define INCLUDE_AGENT_BASE_HPP
 
 #include "allocore/io/al_App.hpp"
+#include "helper.hpp"
+#include "entity_store.hpp"
 
 float boundary_radius = 90.0f;
 
+//one agent's row in an EntityStore
+//the kinds of agents derive from this and keep only their own decision
+//state; position, money and clocks are reached through the accessors, so
+//the steering code reads the same as before. integrating, the border and
+//the bookkeeping run over the columns in EntityStore, not per agent.
 struct Agent{
-    Vec3f velocity, acceleration;
-    Pose pose;
-    Color c;
-    Quatd q;
-    MeshVBO body;
-    float maxspeed;
-    float minspeed;
-    float mass;
-    float initialRadius;
-    float maxAcceleration;
-    float maxforce;
-    float target_senseRadius;
-    float desiredseparation;
-    float scaleFactor;
-    int bioClock;
-    float capitalHoldings;
-    float poetryHoldings;
-    float livingCost;
-    float lastSavings;
-    float currentSavings;
-    float todayIncome;
-    float monthlyTotal;
-    float monthlyIncome;
-    float dailyIncome;
-    int moneyTimer;
-    float incomeTax;
-    float povertyWelfare;
-    Vec3f movingTarget;
+    EntityStore* store;
+    unsigned id;
+
+    Agent(EntityStore& s){
+        store = &s;
+        id = s.add();
+    }
+
+    Vec3f& position(){ return store->kinematics.position[id]; }
+    const Vec3f& position() const { return store->kinematics.position[id]; }
+    Vec3f& velocity(){ return store->kinematics.velocity[id]; }
+    Quatd& orientation(){ return store->kinematics.orientation[id]; }
+    float& capitalHoldings(){ return store->ledger.capitalHoldings[id]; }
+    float capitalHoldings() const { return store->ledger.capitalHoldings[id]; }
+    float& poetryHoldings(){ return store->ledger.poetryHoldings[id]; }
+    float& livingCost(){ return store->ledger.livingCost[id]; }
+    int& bioClock(){ return store->clocks.bioClock[id]; }
+    int& desireChangeRate(){ return store->clocks.desireChangeRate[id]; }
+    Vec3f& movingTarget(){ return store->clocks.movingTarget[id]; }
+    const Traits& traits() const { return store->traits; }
+
+    bool bankrupted() const {
+        return store->bankrupted(id);
+    }
 
-    void update(){
-        velocity += acceleration;
-        if (velocity.mag() > maxspeed){
-            velocity.normalize(maxspeed);
-        }
-        pose.pos() += velocity;
-        acceleration *= 0; //zeros acceleration
-        
-    }    
     void applyForce(Vec3f force){
-      Vec3f f = force / mass;
-      acceleration += f;
-      if (acceleration.mag() > maxAcceleration){
-        acceleration.normalize(maxAcceleration);
-      }
+        store->applyForce(id, force);
     }
 
-    void facingToward(Vec3f& target){
+    void facingToward(const Vec3f& target){
         //change facing direction based on target
-        Vec3f src = Vec3f(pose.quat().toVectorZ()).normalize();
-        Vec3f dst = Vec3f(target - pose.pos()).normalize();
+        Vec3f src = Vec3f(orientation().toVectorZ()).normalize();
+        Vec3f dst = Vec3f(target - position()).normalize();
         Quatd rot = Quatd::getRotationTo(src,dst);
-        pose.quat() = rot * pose.quat();
+        orientation() = rot * orientation();
     }
 
     Vec3f seek(Vec3f target){
-        Vec3f desired = target - pose.pos();
+        Vec3f desired = target - position();
         desired.normalized();
-        desired *= maxspeed;
-        Vec3f steer = desired - velocity;
-        if (steer.mag() > maxforce){
-            steer.normalize(maxforce);
+        desired *= traits().maxspeed;
+        Vec3f steer = desired - velocity();
+        if (steer.mag() > traits().maxforce){
+            steer.normalize(traits().maxforce);
         }
         return steer;
     }
@@ -74,57 +64,41 @@ struct Agent{
     void inherentDesire(float desireLevel, float innerRadius, float outerRadius, int changeRate){
         //inherent desire that changes everyday
         //let them search for something in the metropolis
-        bioClock++;
-        if (bioClock % changeRate == 0) {
-            movingTarget = r();
-            Vec3f temp_pos = movingTarget;
-            movingTarget = movingTarget * (outerRadius - innerRadius) + temp_pos.normalize(innerRadius);
+        bioClock()++;
+        if (bioClock() % changeRate == 0) {
+            Vec3f target = r();
+            Vec3f temp_pos = target;
+            movingTarget() = target * (outerRadius - innerRadius) + temp_pos.normalize(innerRadius);
         }
-        if (bioClock > 1440 ){
-            bioClock = 0;
+        if (bioClock() > 1440 ){
+            bioClock() = 0;
         }
-        Vec3f skTarget(seek(movingTarget));
+        Vec3f skTarget(seek(movingTarget()));
         skTarget *= desireLevel;
         applyForce(skTarget);
 
-        Vec3f ar(arrive(movingTarget));
+        Vec3f ar(arrive(movingTarget()));
         ar *= 0.3;
         applyForce(ar);
     }
 
-    Vec3f arrive(Vec3f& target){
-        Vec3f desired = target - pose.pos();
+    Vec3f arrive(const Vec3f& target){
+        Vec3f desired = target - position();
         float d = desired.mag();
         desired.normalize();
-        if (d < target_senseRadius){
-            float m = MapValue(d, 0, target_senseRadius, minspeed, maxspeed);
+        if (d < traits().target_senseRadius){
+            float m = MapValue(d, 0, traits().target_senseRadius, traits().minspeed, traits().maxspeed);
             desired *= m;
         } else {
-            desired *= maxspeed;
+            desired *= traits().maxspeed;
         }
-        Vec3f steer = desired - velocity;
-        if (steer.mag() > maxforce){
-            steer.normalize(maxforce);
+        Vec3f steer = desired - velocity();
+        if (steer.mag() > traits().maxforce){
+            steer.normalize(traits().maxforce);
         }
         return steer;
     }
-
-    //border detect
-    void borderDetect(){
-        Vec3f origin(0,0,0);
-        Vec3f distance = pose.pos() - origin;
-        if (distance.mag() > boundary_radius) {
-            Vec3f desired = origin - pose.pos();
-            Vec3f steer = desired - velocity;
-            if (steer.mag() > maxforce) {
-                steer.normalize(maxforce);
-            }
-            applyForce(steer);
-        } else {
-            applyForce(Vec3f(0,0,0));
-        }
-    }
 };
 
 
-#endif
\ No newline at end of file
+#endif
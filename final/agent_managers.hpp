@@ -4,17 +4,51 @@
 #include "allocore/io/al_App.hpp"
 #include "meshes.hpp"
 #include "agents.hpp"
+#include "voices.hpp"
+
+//each manager owns the EntityStore of its kind, the records with the
+//kind's own state (cs, ms, workers, row i of the store is record i), the
+//meshes the whole kind shares and the voices of the agents that are heard.
+//a tick is the per agent decisions followed by column passes over the store.
 
 struct Capitalist_Entity{
+    EntityStore store;
     vector<Capitalist> cs;
+    vector<CapitalistVoice> voices;
+    vector<MeshVBO> meshes;
     int initial_num;
 
     Capitalist_Entity(){
         initial_num = 15;
-        cs.resize(initial_num);
+        store.traits = Capitalist::defaults();
+
+        //draw body, every capitalist starts as rich as the others
+        meshes.resize(1);
+        MeshVBO& body = meshes[0];
+        float bodyRadius = MapValue(25000.0, 0, 100000.0, 3, 6);
+        int mesh_Nv = addTetrahedron(body,bodyRadius);
+        //mesh_Nv = addCone(body, bodyRadius, Vec3f(0,0,bodyRadius * 3));
+        for(int i=0; i<mesh_Nv; ++i){
+			float f = float(i)/mesh_Nv;
+			body.color(HSV(f*0.1,0.9,1));
+		}
+        body.decompress();
+        body.generateNormals();
 
+        spawn(initial_num);
+        voices.resize(initial_num);
+        for (int i = 0; i < initial_num; i ++){
+            store.voice[i] = i;
+        }
+    }
+    void spawn(int n){
+        store.reserve(cs.size() + n);
+        cs.reserve(cs.size() + n);
+        for (int i = 0; i < n; i ++){
+            cs.push_back(Capitalist(store));
+        }
     }
-    Capitalist operator[] (const int index) const{
+    const Capitalist& operator[] (const int index) const{
         return cs[index];
     }
     void initID(){
@@ -24,7 +58,7 @@ struct Capitalist_Entity{
     }
 
     void getResource(vector<Miner>& miners){
-    
+
         for (int j = miners.size() - 1; j >= 0; j --){
             if (miners[j].exchanging == true){
                 if (miners[j].tradeTimer == miners[j].unloadTimeCost - 1){
@@ -32,7 +66,7 @@ struct Capitalist_Entity{
                     if (!cs[miners[j].id_ClosestCapitalist].bankrupted()){
                         cs[miners[j].id_ClosestCapitalist].resourceHoldings += miners[j].resourceHoldings;
                         cs[miners[j].id_ClosestCapitalist].totalResourceHoldings += miners[j].resourceHoldings;
-                        cs[miners[j].id_ClosestCapitalist].capitalHoldings -= miners[j].resourceHoldings * cs[miners[j].id_ClosestCapitalist].resourceUnitPrice;
+                        cs[miners[j].id_ClosestCapitalist].capitalHoldings() -= miners[j].resourceHoldings * cs[miners[j].id_ClosestCapitalist].resourceUnitPrice;
                     }
                 }
             }
@@ -46,29 +80,48 @@ struct Capitalist_Entity{
                 cs[i].workersPayCheck = fs[i].laborUnitPrice * cs[i].numWorkers;
                 if (fs[i].profitTimer == 359){
                     //cout << "earning profiting" << endl;
-                    cs[i].capitalHoldings += fs[i].grossProfits;
+                    cs[i].capitalHoldings() += fs[i].grossProfits;
                 }
             }
         }
     }
-    void run(vector<MetroBuilding>& mbs){
+    void run(const WorldIndex& world, vector<MetroBuilding>& mbs){
+        decide(world, mbs);
+        move(0, cs.size());
+    }
+    //the per agent half of run, one agent after another
+    void decide(const WorldIndex& world, vector<MetroBuilding>& mbs){
+        store.wake();
         for (int i = cs.size() - 1; i >= 0; i --){
-            Capitalist& c = cs[i];
-            if (!c.bankrupted()){
-                c.run(mbs);
+            if (store.awake[i]){
+                cs[i].run(world, mbs);
             }
         }
     }
+    //the column half of run, any range of rows on its own
+    void move(unsigned begin, unsigned end){
+        store.step(boundary_radius, begin, end);
+    }
     void draw(Graphics& g){
+        Kinematics& k = store.kinematics;
         for (int i = cs.size() - 1; i >= 0; i --){
-            Capitalist& c = cs[i];
-            c.draw(g);
+            g.pushMatrix();
+            g.translate(k.position[i]);
+            g.rotate(k.orientation[i]);
+            g.scale(store.traits.scaleFactor);
+            if (!store.bankrupted(i)){
+                g.draw(meshes[store.mesh[i]]);
+            }
+            g.popMatrix();
         }
     }
 };
 
 struct Worker_Union{
+    EntityStore store;
     vector<Worker> workers;
+    vector<WorkerVoice> voices;
+    vector<MeshVBO> meshes;
     int initial_num;
 
     //visualize relations;
@@ -77,11 +130,37 @@ struct Worker_Union{
 
     Worker_Union(){
         initial_num = 75;
-        workers.resize(initial_num);
-        lines.resize(workers.size());
+        store.traits = Worker::defaults();
+
+        //draw body
+        meshes.resize(1);
+        MeshVBO& body = meshes[0];
+        float bodyRadius = MapValue(4000.0, 0, 100000.0, 1, 3);
+        float bodyHeight = bodyRadius * 3;
+        int mesh_Nv = addCone(body, bodyRadius, Vec3f(0,0,bodyHeight));
+        for(int i=0; i<mesh_Nv; ++i){
+			float f = float(i)/mesh_Nv;
+			body.color(HSV(f*0.2+0.4,1,1));
+		}
+        body.decompress();
+        body.generateNormals();
+
+        spawn(initial_num);
+        voices.resize(initial_num);
+        for (int i = 0; i < initial_num; i ++){
+            store.voice[i] = i;
+        }
         drawingLinks = true;
     }
-    Worker operator[] (const int index) const{
+    void spawn(int n){
+        store.reserve(workers.size() + n);
+        workers.reserve(workers.size() + n);
+        for (int i = 0; i < n; i ++){
+            workers.push_back(Worker(store));
+        }
+        lines.resize(workers.size());
+    }
+    const Worker& operator[] (const int index) const{
         return workers[index];
     }
     void initID(){
@@ -89,20 +168,27 @@ struct Worker_Union{
             workers[i].workerID = i;
         }
     }
-    void run(vector<Factory>& fs, vector<Worker>& others, vector<Capitalist>& capitalist){
+    void run(const WorldIndex& world, vector<Factory>& fs, vector<Capitalist>& capitalist){
+        decide(world, fs, capitalist);
+        move(0, workers.size());
+        visualize(fs);
+    }
+    void decide(const WorldIndex& world, vector<Factory>& fs, vector<Capitalist>& capitalist){
+        store.wake();
         for (int i = workers.size() - 1; i >= 0; i --){
-            Worker& w = workers[i];
-            if (!w.bankrupted()){
-                w.run(fs, others, capitalist);
+            if (store.awake[i]){
+                workers[i].run(world, fs, capitalist);
             }
         }
-        visualize(fs);
+    }
+    void move(unsigned begin, unsigned end){
+        store.step(boundary_radius, begin, end);
     }
     void visualize(vector<Factory>& fs){
         if (drawingLinks){
             for (int i = workers.size() - 1; i >= 0; i--){
-                if (workers[i].FactoryFound && !workers[i].bankrupted()){
-                    lines[i].vertices()[0] = workers[i].pose.pos();
+                if (workers[i].FactoryFound && !store.bankrupted(i)){
+                    lines[i].vertices()[0] = store.kinematics.position[i];
                     lines[i].vertices()[1] = fs[workers[i].id_ClosestFactory].position;
                 } else {
                     lines[i].vertices()[0] = Vec3f(0,0,0);
@@ -119,9 +205,16 @@ struct Worker_Union{
         }
     }
     void draw(Graphics& g){
+        Kinematics& k = store.kinematics;
         for (int i = workers.size() - 1; i >=0; i --){
-            Worker& w = workers[i];
-            w.draw(g);
+            g.pushMatrix();
+            g.translate(k.position[i]);
+            g.rotate(k.orientation[i]);
+            g.scale(store.traits.scaleFactor);
+            if (!store.bankrupted(i)){
+                g.draw(meshes[store.mesh[i]]);
+            }
+            g.popMatrix();
             g.color(0.4,0.65,1);
             g.draw(lines[i]);
         }
@@ -129,7 +222,10 @@ struct Worker_Union{
 };
 
 struct Miner_Group{
+    EntityStore store;
     vector<Miner> ms;
+    vector<MeshVBO> meshes;
+    Mesh resource;  //carried on the back of a full miner
     int initial_num;
 
     //visualize relations
@@ -138,26 +234,57 @@ struct Miner_Group{
 
     Miner_Group(){
         initial_num = 100;
-        ms.resize(initial_num);
-        lines.resize(ms.size());
+        store.traits = Miner::defaults();
+
+        //draw body
+        meshes.resize(1);
+        MeshVBO& body = meshes[0];
+        float bodyRadius = MapValue(5000.0, 0, 100000.0, 1, 3);
+        float bodyHeight = bodyRadius * 3;
+        int mesh_Nv = addCone(body, bodyRadius, Vec3f(0,0,bodyHeight));
+        for(int i=0; i<mesh_Nv; ++i){
+			float f = float(i)/mesh_Nv;
+			body.color(HSV(f*0.1+0.2,1,1));
+		}
+        addCube(resource, 4);
+        resource.generateNormals();
+        body.decompress();
+        body.generateNormals();
+
+        spawn(initial_num);
         drawingLinks = true;
 
     }
-    Miner operator[] (const int index) const{
+    void spawn(int n){
+        store.reserve(ms.size() + n);
+        ms.reserve(ms.size() + n);
+        for (int i = 0; i < n; i ++){
+            ms.push_back(Miner(store));
+        }
+        lines.resize(ms.size());
+    }
+    const Miner& operator[] (const int index) const{
         return ms[index];
     }
-    void run(vector<Natural_Resource_Point>& nrps, vector<Miner>& others, vector<Capitalist>& capitalists){
+    void run(const WorldIndex& world, vector<Natural_Resource_Point>& nrps, vector<Capitalist>& capitalists){
+        decide(world, nrps, capitalists);
+        move(0, ms.size());
+        //drawing links
+        visualize(nrps);
+    }
+    void decide(const WorldIndex& world, vector<Natural_Resource_Point>& nrps, vector<Capitalist>& capitalists){
+        store.wake();
         for (int i = ms.size() - 1; i >=0; i --){
-            Miner& m = ms[i];
-            if (!m.bankrupted()){
-                m.run(nrps, others, capitalists);
+            if (store.awake[i]){
+                ms[i].run(world, nrps, capitalists);
             }
         }
-        //drawing links
-        visualize(nrps);
+    }
+    void move(unsigned begin, unsigned end){
+        store.step(boundary_radius, begin, end);
     }
     void calculateResourceUnitPrice(vector<Factory>& factories){
-        // miners are not aware of the value of their work, 
+        // miners are not aware of the value of their work,
         // rather they believe the resource is evaluated at the factory,
         // not based on their own work
         for (int i = ms.size() - 1; i >=0; i --){
@@ -167,8 +294,8 @@ struct Miner_Group{
     void visualize(vector<Natural_Resource_Point>& nrps){
         if (drawingLinks){
             for (int i = ms.size() - 1; i >= 0; i--){
-                if (ms[i].resourcePointFound && !ms[i].bankrupted()){
-                    lines[i].vertices()[0] = ms[i].pose.pos();
+                if (ms[i].resourcePointFound && !store.bankrupted(i)){
+                    lines[i].vertices()[0] = store.kinematics.position[i];
                     lines[i].vertices()[1] = nrps[ms[i].id_ClosestNRP].resources[ms[i].id_ClosestResource].position;
                 } else {
                     lines[i].vertices()[0] = Vec3f(0,0,0);
@@ -189,16 +316,24 @@ struct Miner_Group{
         //push line
     }
     void die(){
-        
+
     }
     void draw(Graphics& g){
+        Kinematics& k = store.kinematics;
         for (int i = ms.size() - 1; i >=0; i --){
-            Miner& m = ms[i];
-            m.draw(g);
+            g.pushMatrix();
+            g.translate(k.position[i]);
+            g.rotate(k.orientation[i]);
+            g.scale(store.traits.scaleFactor);
+            if (!store.bankrupted(i)){
+                if (ms[i].resourceHoldings >= 12){ g.draw(resource);}
+                g.draw(meshes[store.mesh[i]]);
+            }
+            g.popMatrix();
             g.color(0.6,1,0.6);
             g.draw(lines[i]);
         }
     }
 };
 
-#endif
\ No newline at end of file
+#endif
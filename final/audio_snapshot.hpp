@@ -0,0 +1,52 @@
+#ifndef INCLUDE_AUDIO_SNAPSHOT_HPP
+#define INCLUDE_AUDIO_SNAPSHOT_HPP
+
+#include <vector>
+#include "allocore/io/al_App.hpp"
+#include "agent_managers.hpp"
+#include "../gravity/control_channel.hpp"
+
+using namespace al;
+using namespace std;
+
+//what the audio thread needs of the agents, copied once per tick
+//the simulation captures it after the tick and publishes it through a
+//ControlChannel; the audio thread picks up the latest one at the start of
+//a block and reads nothing else of the simulation, so neither waits on
+//the other and a block never sees a tick half written. the voices
+//themselves belong to the audio thread, their parameters arrive here.
+struct AgentSound{
+    Vec3f ear;                          //the listener
+    vector<Vec3f> capitalistPosition;
+    vector<int> capitalistVoice;        //-1 for none
+    vector<Vec3f> workerPosition;
+    vector<int> workerVoice;
+    vector<float> workerNoise;          //the crowd around each worker, its voice's noiseLevel
+
+    //simulation thread, after the tick
+    void capture(const Capitalist_Entity& capitalists, const Worker_Union& workers, const Vec3d& listener){
+        ear = Vec3f(listener.x, listener.y, listener.z);
+        unsigned numCapitalists = capitalists.cs.size();
+        capitalistPosition.resize(numCapitalists);
+        capitalistVoice.resize(numCapitalists);
+        for (unsigned i = 0; i < numCapitalists; ++i){
+            capitalistPosition[i] = capitalists.store.kinematics.position[i];
+            capitalistVoice[i] = capitalists.store.voice[i];
+        }
+        unsigned numWorkers = workers.workers.size();
+        workerPosition.resize(numWorkers);
+        workerVoice.resize(numWorkers);
+        workerNoise.resize(numWorkers);
+        for (unsigned i = 0; i < numWorkers; ++i){
+            workerPosition[i] = workers.store.kinematics.position[i];
+            workerVoice[i] = workers.store.voice[i];
+            workerNoise[i] = workers.workers[i].noiseLevel;
+        }
+    }
+
+    unsigned candidates() const {
+        return capitalistPosition.size() + workerPosition.size();
+    }
+};
+
+#endif
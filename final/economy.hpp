@@ -0,0 +1,55 @@
+#ifndef INCLUDE_ECONOMY_HPP
+#define INCLUDE_ECONOMY_HPP
+
+#include "allocore/io/al_App.hpp"
+#include "helper.hpp"
+#include "agent_managers.hpp"
+#include "location_managers.hpp"
+#include "spatial_index.hpp"
+#include "tick_schedule.hpp"
+
+using namespace al;
+using namespace std;
+
+//the locations, the agents and the market, with nothing to show or play
+//them: no window, no audio, no cuttlebone, no interface server. built the
+//way the simulator builds them and stepped by the same TickSchedule, so a
+//tick here is a tick there, only as often as the cpu allows.
+struct Economy{
+    enum { TICKS_PER_DAY = 60 };    //the ledger closes a day every 60 ticks
+
+    //they draw random numbers as they are built, so a headless run repeats
+    //itself for a seed. it does not replay the interactive simulator: that
+    //draws its background geometry first, builds the market after the
+    //schedule and is never seeded
+    Metropolis metropolis;
+    Factories factories;
+    NaturalResourcePointsCollection NaturalResourcePts;
+    Capitalist_Entity capitalists;
+    Miner_Group miners;
+    Worker_Union workers;
+    MarketManager marketManager;
+    WorldIndex world;
+    TickSchedule schedule;
+    unsigned long ticks;
+
+    Economy(){
+        factories.generate(capitalists);
+        metropolis.generate(capitalists);
+        marketManager.statsInit(capitalists, workers, miners);
+        workers.initID();
+        schedule.declare(marketManager, metropolis, factories, NaturalResourcePts, capitalists, miners, workers, world);
+        ticks = 0;
+    }
+
+    void tick(){
+        schedule.run();
+        ticks ++;
+    }
+
+    double days() const {
+        return ticks / (double)TICKS_PER_DAY;
+    }
+};
+
+#endif
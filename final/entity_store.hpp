@@ -0,0 +1,259 @@
+#ifndef INCLUDE_ENTITY_STORE_HPP
+#define INCLUDE_ENTITY_STORE_HPP
+
+#include <vector>
+#include "allocore/io/al_App.hpp"
+
+using namespace al;
+using namespace std;
+
+//simulation state of one kind of agent, one column per field
+//a tick walks every agent several times (steer, integrate, pay the bills)
+//and each walk needs a handful of fields, so they are packed in their own
+//arrays instead of strided through whole agents with meshes and dsp in
+//them. columns are grouped by who reads them: kinematics and the ledger
+//every tick, the clocks when an agent decides where to go, the voice and
+//mesh ids only from audio and drawing. whatever is the same for the whole
+//kind lives once in Traits. the decisions particular to a kind stay in its
+//own record (Miner, Worker, Capitalist), which reaches its row through
+//Agent in agent_base.hpp.
+
+struct Traits{
+    float maxspeed;
+    float minspeed;
+    float maxforce;
+    float maxAcceleration;
+    float mass;
+    float target_senseRadius;
+    float desiredseparation;
+    float scaleFactor;
+
+    //money
+    float floor;            //holdings never go lower, an agent here is bankrupt
+    float bracketCost[4];   //living cost by monthly income: up to 5000, 8000, 15000, more
+    bool bracketed;         //false leaves every agent its own living cost
+    float welfare;          //share of the living cost paid back below 5000 a month
+
+    Traits(){
+        maxspeed = 1;
+        minspeed = 0;
+        maxforce = 1;
+        maxAcceleration = 1;
+        mass = 1;
+        target_senseRadius = 10;
+        desiredseparation = 3;
+        scaleFactor = 1;
+        floor = 0;
+        for (unsigned b = 0; b < 4; ++b) bracketCost[b] = 0;
+        bracketed = false;
+        welfare = 0;
+    }
+};
+
+//touched by every agent every tick
+struct Kinematics{
+    vector<Vec3f> position;
+    vector<Vec3f> velocity;
+    vector<Vec3f> acceleration;
+    vector<Quatd> orientation;
+};
+
+struct Ledger{
+    vector<float> capitalHoldings;
+    vector<float> poetryHoldings;
+    vector<float> livingCost;
+    vector<float> lastSavings;
+    vector<float> currentSavings;
+    vector<float> todayIncome;
+    vector<float> monthlyTotal;
+    vector<float> monthlyIncome;
+    vector<float> dailyIncome;
+    vector<float> incomeTax;
+    vector<float> povertyWelfare;
+    vector<int> moneyTimer;
+};
+
+//ai timers
+struct Clocks{
+    vector<int> bioClock;
+    vector<int> desireChangeRate;
+    vector<Vec3f> movingTarget;
+};
+
+struct EntityStore{
+    Traits traits;
+    Kinematics kinematics;
+    Ledger ledger;
+    Clocks clocks;
+    vector<int> voice;              //index into the manager's voices, -1 for none
+    vector<unsigned char> mesh;     //index into the manager's meshes
+    vector<unsigned char> awake;    //was not bankrupt when the tick began
+
+    unsigned size() const {
+        return kinematics.position.size();
+    }
+
+    void reserve(unsigned n){
+        kinematics.position.reserve(n);
+        kinematics.velocity.reserve(n);
+        kinematics.acceleration.reserve(n);
+        kinematics.orientation.reserve(n);
+        ledger.capitalHoldings.reserve(n);
+        ledger.poetryHoldings.reserve(n);
+        ledger.livingCost.reserve(n);
+        ledger.lastSavings.reserve(n);
+        ledger.currentSavings.reserve(n);
+        ledger.todayIncome.reserve(n);
+        ledger.monthlyTotal.reserve(n);
+        ledger.monthlyIncome.reserve(n);
+        ledger.dailyIncome.reserve(n);
+        ledger.incomeTax.reserve(n);
+        ledger.povertyWelfare.reserve(n);
+        ledger.moneyTimer.reserve(n);
+        clocks.bioClock.reserve(n);
+        clocks.desireChangeRate.reserve(n);
+        clocks.movingTarget.reserve(n);
+        voice.reserve(n);
+        mesh.reserve(n);
+        awake.reserve(n);
+    }
+
+    //a new row, at rest with empty pockets
+    unsigned add(){
+        unsigned i = size();
+        kinematics.position.push_back(Vec3f(0,0,0));
+        kinematics.velocity.push_back(Vec3f(0,0,0));
+        kinematics.acceleration.push_back(Vec3f(0,0,0));
+        kinematics.orientation.push_back(Quatd());
+        ledger.capitalHoldings.push_back(0);
+        ledger.poetryHoldings.push_back(0);
+        ledger.livingCost.push_back(0);
+        ledger.lastSavings.push_back(0);
+        ledger.currentSavings.push_back(0);
+        ledger.todayIncome.push_back(0);
+        ledger.monthlyTotal.push_back(0);
+        ledger.monthlyIncome.push_back(0);
+        ledger.dailyIncome.push_back(0);
+        ledger.incomeTax.push_back(0);
+        ledger.povertyWelfare.push_back(0);
+        ledger.moneyTimer.push_back(0);
+        clocks.bioClock.push_back(0);
+        clocks.desireChangeRate.push_back(1);
+        clocks.movingTarget.push_back(Vec3f(0,0,0));
+        voice.push_back(-1);
+        mesh.push_back(0);
+        awake.push_back(1);
+        return i;
+    }
+
+    bool bankrupted(unsigned i) const {
+        return ledger.capitalHoldings[i] <= traits.floor;
+    }
+
+    //bankrupt agents sit the whole tick out
+    void wake(){
+        for (unsigned i = 0; i < size(); ++i){
+            awake[i] = !bankrupted(i);
+        }
+    }
+
+    void applyForce(unsigned i, const Vec3f& force){
+        Vec3f& a = kinematics.acceleration[i];
+        a += force / traits.mass;
+        if (a.mag() > traits.maxAcceleration){
+            a.normalize(traits.maxAcceleration);
+        }
+    }
+
+    //the column passes of a tick over rows [begin, end)
+    //every row only touches itself, so ranges can run on different threads
+    void step(float radius, unsigned begin, unsigned end){
+        keepInside(radius, begin, end);
+        integrate(begin, end);
+        settle(begin, end);
+    }
+
+    //steer everyone who wandered past radius back toward the origin
+    void keepInside(float radius, unsigned begin, unsigned end){
+        float radius2 = radius * radius;
+        for (unsigned i = begin; i < end; ++i){
+            if (!awake[i]) continue;
+            const Vec3f& p = kinematics.position[i];
+            if (p.magSqr() > radius2){
+                Vec3f steer = -p - kinematics.velocity[i];
+                if (steer.mag() > traits.maxforce){
+                    steer.normalize(traits.maxforce);
+                }
+                applyForce(i, steer);
+            }
+        }
+    }
+
+    void integrate(unsigned begin, unsigned end){
+        float maxspeed2 = traits.maxspeed * traits.maxspeed;
+        for (unsigned i = begin; i < end; ++i){
+            if (!awake[i]) continue;
+            Vec3f& v = kinematics.velocity[i];
+            v += kinematics.acceleration[i];
+            if (v.magSqr() > maxspeed2){
+                v.normalize(traits.maxspeed);
+            }
+            kinematics.position[i] += v;
+            kinematics.acceleration[i] = Vec3f(0,0,0);
+        }
+    }
+
+    //daily and monthly bookkeeping, income tax and the cost of living
+    void settle(unsigned begin, unsigned end){
+        Ledger& l = ledger;
+        for (unsigned i = begin; i < end; ++i){
+            if (!awake[i]) continue;
+            l.moneyTimer[i] ++;
+            if (l.moneyTimer[i] == 0){
+                l.lastSavings[i] = l.capitalHoldings[i];
+                l.monthlyTotal[i] = 0;
+            }
+            if (l.moneyTimer[i] % 60 == 0){
+                l.currentSavings[i] = l.capitalHoldings[i];
+                l.todayIncome[i] = l.currentSavings[i] - l.lastSavings[i];
+                l.monthlyTotal[i] += l.todayIncome[i];
+                l.lastSavings[i] = l.currentSavings[i];
+            }
+            if (l.moneyTimer[i] > 60 * 15){
+                l.monthlyIncome[i] = l.monthlyTotal[i];
+                l.dailyIncome[i] = l.monthlyIncome[i] / 30;
+                l.moneyTimer[i] = 0;
+            }
+            float monthly = l.monthlyIncome[i];
+            int bracket = -1;
+            if (monthly > 5000 && monthly <= 8000){
+                l.incomeTax[i] = l.dailyIncome[i] * 0.008;
+                bracket = 1;
+            } else if (monthly > 8000 && monthly <= 15000){
+                l.incomeTax[i] = l.dailyIncome[i] * 0.012;
+                bracket = 2;
+            } else if (monthly > 15000){
+                l.incomeTax[i] = l.dailyIncome[i] * 0.018;
+                bracket = 3;
+            } else if (monthly <= 5000){
+                l.incomeTax[i] = 0;
+                bracket = 0;
+            }
+            if (traits.bracketed && bracket >= 0){
+                l.livingCost[i] = traits.bracketCost[bracket];
+            }
+            if (bracket == 0 && traits.welfare > 0){
+                l.povertyWelfare[i] = - l.livingCost[i] * traits.welfare;
+            }
+
+            l.capitalHoldings[i] -= l.livingCost[i] + l.incomeTax[i] + l.povertyWelfare[i];
+            if (l.capitalHoldings[i] <= traits.floor){
+                l.capitalHoldings[i] = traits.floor;
+            } else if (l.capitalHoldings[i] >= 9999999){
+                l.capitalHoldings[i] = 9999999;
+            }
+        }
+    }
+};
+
+#endif
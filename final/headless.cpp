@@ -0,0 +1,160 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include "economy.hpp"
+#include "market_recorder.hpp"
+using namespace al;
+using namespace std;
+
+//the economy fast forward, no window, no audio, no network
+//builds an Economy and ticks it as fast as the cpu allows for a number of
+//ticks or simulated days, printing the market every --every days and the
+//throughput at the end. a day is the ledger's, 60 ticks, so a second of
+//the app at 60 fps; a year of days takes 21900 ticks.
+//
+//build it like the other final apps, e.g.
+//  c++ -O3 -march=native -std=c++11 -pthread headless.cpp -lallocore -lGamma -o headless
+//
+//usage: headless [--days 30 | --ticks 1800] [--every 1] [--threads 1]
+//                [--seed 1] [--csv] [--record market.mkts [--metrics a,b]
+//                [--record-every 1] [--export market.csv]]
+//
+//--record keeps every market metric (or those named in --metrics) of
+//every tick in a columnar file written behind the run, --export turns it
+//into a csv table once the run is over.
+//
+//the same seed and tick count give the same economy on any thread count.
+
+struct RunConfig{
+    unsigned long ticks;
+    double every;       //days between market lines, 0 for none
+    unsigned threads;
+    unsigned seed;
+    bool csv;
+    string record;      //market recording, none when empty
+    string metrics;
+    unsigned recordEvery;
+    string exportCsv;
+
+    RunConfig(){
+        ticks = 30 * Economy::TICKS_PER_DAY;
+        every = 1;
+        threads = 1;
+        seed = 1;
+        csv = false;
+        recordEvery = 1;
+    }
+};
+
+void printHeader(const RunConfig& config){
+    if (config.csv){
+        printf("day,ticks,ticks_per_sec,resource_price,labor_price,live_capitalists,live_workers,live_miners,"
+               "job_hunting,capitalist_wealth,worker_wealth,miner_wealth,poor_workers,poor_miners\n");
+    } else {
+        printf("%8s %10s %11s %9s %9s %13s %11s %11s %11s\n", "day", "ticks/sec", "live c/w/m", "resource",
+               "labor", "capitalist $", "worker $", "miner $", "job hunting");
+    }
+}
+
+void printMarket(const Economy& e, const RunConfig& config, double ticksPerSec){
+    const MarketManager& m = e.marketManager;
+    if (config.csv){
+        printf("%.2f,%lu,%.0f,%.3f,%.3f,%g,%g,%g,%g,%.2f,%.2f,%.2f,%g,%g\n", e.days(), e.ticks, ticksPerSec,
+               m.resourceUnitPrice, m.laborUnitPrice, m.liveCapitalists, m.liveWorkers, m.liveMiners,
+               m.jobHuntingWorkers, m.averageCapitalistWealth, m.averageWorkerWealth, m.averageMinerWealth,
+               m.poorWorkers, m.poorMiners);
+    } else {
+        char live[64];  //three %g of up to 13 characters each
+        snprintf(live, sizeof(live), "%g/%g/%g", m.liveCapitalists, m.liveWorkers, m.liveMiners);
+        printf("%8.1f %10.0f %11s %9.2f %9.2f %13.1f %11.1f %11.1f %11g\n", e.days(), ticksPerSec, live,
+               m.resourceUnitPrice, m.laborUnitPrice, m.averageCapitalistWealth, m.averageWorkerWealth,
+               m.averageMinerWealth, m.jobHuntingWorkers);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[]){
+    RunConfig config;
+    for (int i = 1; i < argc; ++i){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--ticks" && hasValue){
+            config.ticks = strtoul(argv[++i], 0, 10);
+        } else if (arg == "--days" && hasValue){
+            config.ticks = (unsigned long)(atof(argv[++i]) * Economy::TICKS_PER_DAY);
+        } else if (arg == "--every" && hasValue){
+            config.every = atof(argv[++i]);
+        } else if (arg == "--threads" && hasValue){
+            config.threads = atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue){
+            config.seed = atoi(argv[++i]);
+        } else if (arg == "--record" && hasValue){
+            config.record = argv[++i];
+        } else if (arg == "--metrics" && hasValue){
+            config.metrics = argv[++i];
+        } else if (arg == "--record-every" && hasValue){
+            config.recordEvery = atoi(argv[++i]);
+        } else if (arg == "--export" && hasValue){
+            config.exportCsv = argv[++i];
+        } else if (arg == "--csv"){
+            config.csv = true;
+        } else {
+            fprintf(stderr, "unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    //both generators the agents draw from
+    srand(config.seed);
+    rnd::global().seed(config.seed);
+
+    //the managers chat on cout, keep it out of the csv
+    if (config.csv) cout.setstate(ios::failbit);
+
+    Economy economy;
+    economy.schedule.threads(config.threads);
+    MarketRecorder recorder;
+    if (!config.record.empty()){
+        if (!config.metrics.empty() && !recorder.select(config.metrics)) return 1;
+        if (!recorder.open(config.record.c_str(), 1024, 8, config.recordEvery)) return 1;
+    }
+    if (!config.csv){
+        printf("%lu ticks (%.1f days), %u threads, seed %u\n", config.ticks,
+               config.ticks / (double)Economy::TICKS_PER_DAY, economy.schedule.pool.size(), config.seed);
+    }
+    printHeader(config);
+
+    unsigned long every = (unsigned long)(config.every * Economy::TICKS_PER_DAY);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point lap = start;
+    unsigned long lapTicks = 0;
+    for (unsigned long t = 0; t < config.ticks; ++t){
+        economy.tick();
+        recorder.record(economy.marketManager, economy.ticks);
+        if (every > 0 && economy.ticks % every == 0){
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            double s = chrono::duration<double>(now - lap).count();
+            printMarket(economy, config, s > 0 ? (economy.ticks - lapTicks) / s : 0);
+            lap = now;
+            lapTicks = economy.ticks;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    recorder.close();
+    if (!config.exportCsv.empty()){
+        if (config.record.empty() || !MarketRecorder::exportCsv(config.record.c_str(), config.exportCsv.c_str())){
+            fprintf(stderr, "cannot export %s\n", config.exportCsv.c_str());
+            return 1;
+        }
+    }
+    double ticksPerSec = seconds > 0 ? config.ticks / seconds : 0;
+    if (config.csv){
+        if (every == 0) printMarket(economy, config, ticksPerSec);
+    } else {
+        printf("%lu ticks in %.3f s: %.0f ticks/sec, %.1f simulated days per second, %.0fx real time at 60 fps\n",
+               config.ticks, seconds, ticksPerSec, ticksPerSec / Economy::TICKS_PER_DAY, ticksPerSec / 60);
+        economy.schedule.graph.report(cout);
+    }
+    return 0;
+}
@@ -33,10 +33,11 @@ struct Metropolis{
             mbs.push_back(m);
         }
     }
-    void mapCapitalistStats(vector<Capitalist>& capitalists){
-        for (int i = 0; i < capitalists.size(); i ++){
-            mbs[i].maxBuildings = capitalists.size();
-            mbs[i].scaleFactorZ = MapValue(capitalists[i].capitalHoldings, 0, 500000, 0.1, 20);
+    void mapCapitalistStats(Capitalist_Entity& capitalists){
+        const vector<float>& holdings = capitalists.store.ledger.capitalHoldings;
+        for (int i = 0; i < holdings.size(); i ++){
+            mbs[i].maxBuildings = holdings.size();
+            mbs[i].scaleFactorZ = MapValue(holdings[i], 0, 500000, 0.1, 20);
             mbs[i].position.x = MetroRadius * 2 * sin(MapValue(mbs[i].buildingID, 0, mbs[i].maxBuildings, 0, M_PI * 2));
             mbs[i].position.y = MetroRadius * 2 * cos(MapValue(mbs[i].buildingID, 0, mbs[i].maxBuildings, 0, M_PI * 2));
             mbs[i].position.z = 0;
@@ -89,7 +90,7 @@ struct Factories {
     void drawLinks(Capitalist_Entity& cs){
         if (drawingLinks){
             for (int i = cs.cs.size() - 1; i >= 0; i --){
-                lines[i].vertices()[0] = cs[i].pose.pos();
+                lines[i].vertices()[0] = cs.store.kinematics.position[i];
                 lines[i].vertices()[1] = fs[i].position;
             }
         } else{
@@ -0,0 +1,307 @@
+#ifndef INCLUDE_MARKET_RECORDER_HPP
+#define INCLUDE_MARKET_RECORDER_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "status_manager.hpp"
+
+using namespace std;
+
+//a statistic of the MarketManager that can be recorded
+struct MarketMetric{
+    const char* name;
+    float MarketManager::* field;
+};
+
+inline const vector<MarketMetric>& marketMetrics(){
+    static const vector<MarketMetric> all = {
+        {"resourceUnitPrice", &MarketManager::resourceUnitPrice},
+        {"laborUnitPrice", &MarketManager::laborUnitPrice},
+        {"numCapitalists", &MarketManager::numCapitalists},
+        {"numWorkers", &MarketManager::numWorkers},
+        {"numMiners", &MarketManager::numMiners},
+        {"liveCapitalists", &MarketManager::liveCapitalists},
+        {"liveWorkers", &MarketManager::liveWorkers},
+        {"liveMiners", &MarketManager::liveMiners},
+        {"liveFactories", &MarketManager::liveFactories},
+        {"jobHuntingWorkers", &MarketManager::jobHuntingWorkers},
+        {"poorCapitalists", &MarketManager::poorCapitalists},
+        {"poorWorkers", &MarketManager::poorWorkers},
+        {"poorMiners", &MarketManager::poorMiners},
+        {"richWorkers", &MarketManager::richWorkers},
+        {"richMiners", &MarketManager::richMiners},
+        {"richCapitalists", &MarketManager::richCapitalists},
+        {"averageCollectRate", &MarketManager::averageCollectRate},
+        {"averageMaxLoad", &MarketManager::averageMaxLoad},
+        {"averageMinerSpeed", &MarketManager::averageMinerSpeed},
+        {"averageCapitalistWealth", &MarketManager::averageCapitalistWealth},
+        {"averageFactoryGrossProfits", &MarketManager::averageFactoryGrossProfits},
+        {"averageWorkerWealth", &MarketManager::averageWorkerWealth},
+        {"averageMinerWealth", &MarketManager::averageMinerWealth},
+        {"averageFactoryCapitalReserve", &MarketManager::averageFactoryCapitalReserve},
+        {"averageWorkersPayCheck", &MarketManager::averageWorkersPayCheck},
+        {"averageFactoryMaterialStocks", &MarketManager::averageFactoryMaterialStocks},
+        {"averageCapitalistResource", &MarketManager::averageCapitalistResource},
+        {"averageMinerPoetryLevel", &MarketManager::averageMinerPoetryLevel},
+        {"averageWorkerPoetryLevel", &MarketManager::averageWorkerPoetryLevel},
+        {"averageCapitalistPoetryLevel", &MarketManager::averageCapitalistPoetryLevel},
+        {"MinerCapitalistRatio", &MarketManager::MinerCapitalistRatio},
+        {"WorkerCapitalistRatio", &MarketManager::WorkerCapitalistRatio},
+        {"resourcePopulationFactor", &MarketManager::resourcePopulationFactor},
+        {"laborPolulationFactor", &MarketManager::laborPolulationFactor},
+        {"minerPovertyRate", &MarketManager::minerPovertyRate},
+        {"minerWealthRate", &MarketManager::minerWealthRate},
+        {"workerPovertyRate", &MarketManager::workerPovertyRate},
+        {"workerWealthRate", &MarketManager::workerWealthRate},
+    };
+    return all;
+}
+
+//market statistics over time, one column per metric
+//record() copies the chosen metrics of one tick into a block of
+//preallocated columns; a full block is handed to a flushing thread and the
+//next free one is filled. the tick path never allocates, locks or waits:
+//if the flusher falls a whole ring of blocks behind, samples are dropped
+//and counted instead.
+//
+//the file is the header followed by one chunk per block:
+//  "MKTS" uint32 version, uint32 columns, per column uint32 length + name
+//  uint32 rows, uint64 first tick, uint32 ticks between rows,
+//  then rows floats of each column in turn
+//exportCsv turns it into a table with a tick column.
+struct MarketRecorder{
+    enum { VERSION = 1 };
+
+    struct Block{
+        vector<float> values;   //column c holds values[c * blockRows ..]
+        uint32_t rows;
+        uint64_t firstTick;
+    };
+
+    vector<unsigned> columns;   //into marketMetrics()
+    vector<Block> blocks;
+    unsigned blockRows;
+    unsigned stride;            //record every stride ticks
+    FILE* file;
+
+    //blocks handed over and blocks written, the ring is full when they
+    //are blocks.size() apart. only the recorder moves the first, only the
+    //flusher the second.
+    atomic<uint64_t> published;
+    atomic<uint64_t> flushed;
+    bool filling;               //the block at published is being filled
+    uint64_t dropped;
+
+    thread flusher;
+    mutex m;
+    condition_variable wake;
+    atomic<bool> closing;
+
+    MarketRecorder(){
+        blockRows = 1024;
+        stride = 1;
+        file = 0;
+        published = 0;
+        flushed = 0;
+        filling = false;
+        dropped = 0;
+        closing = false;
+    }
+    ~MarketRecorder(){
+        close();
+    }
+
+    //comma separated metric names, all of them when never called
+    bool select(const string& names){
+        columns.clear();
+        size_t start = 0;
+        while (start <= names.size()){
+            size_t comma = names.find(',', start);
+            if (comma == string::npos) comma = names.size();
+            string name = names.substr(start, comma - start);
+            start = comma + 1;
+            if (name.empty()) continue;
+            int found = -1;
+            for (unsigned k = 0; k < marketMetrics().size(); ++k){
+                if (name == marketMetrics()[k].name) found = k;
+            }
+            if (found < 0){
+                fprintf(stderr, "no market metric called %s\n", name.c_str());
+                return false;
+            }
+            columns.push_back(found);
+        }
+        return true;
+    }
+
+    //allocates every block up front and starts the flusher
+    bool open(const char* path, unsigned rowsPerBlock = 1024, unsigned numBlocks = 8, unsigned every = 1){
+        close();
+        file = fopen(path, "wb");
+        if (!file){
+            fprintf(stderr, "cannot write %s\n", path);
+            return false;
+        }
+        if (columns.empty()){
+            for (unsigned k = 0; k < marketMetrics().size(); ++k) columns.push_back(k);
+        }
+        blockRows = rowsPerBlock < 1 ? 1 : rowsPerBlock;
+        stride = every < 1 ? 1 : every;
+        blocks.resize(numBlocks < 2 ? 2 : numBlocks);
+        for (Block& b : blocks){
+            b.values.assign(columns.size() * blockRows, 0.0f);
+            b.rows = 0;
+            b.firstTick = 0;
+        }
+        published = 0;
+        flushed = 0;
+        filling = false;
+        dropped = 0;
+        closing = false;
+
+        uint32_t header[3] = { 0, VERSION, (uint32_t)columns.size() };
+        memcpy(header, "MKTS", 4);
+        fwrite(header, sizeof(uint32_t), 3, file);
+        for (unsigned c : columns){
+            const char* name = marketMetrics()[c].name;
+            uint32_t length = strlen(name);
+            fwrite(&length, sizeof(length), 1, file);
+            fwrite(name, 1, length, file);
+        }
+        flusher = thread([this](){ flush(); });
+        return true;
+    }
+
+    bool recording() const {
+        return file != 0;
+    }
+
+    //simulation thread, once per tick after the market has been updated
+    void record(const MarketManager& market, uint64_t tick){
+        if (!file || tick % stride != 0) return;
+        uint64_t p = published.load(memory_order_relaxed);
+        if (!filling){
+            if (p - flushed.load(memory_order_acquire) >= blocks.size()){
+                dropped ++;
+                return;
+            }
+            Block& b = blocks[p % blocks.size()];
+            b.rows = 0;
+            b.firstTick = tick;
+            filling = true;
+        }
+        Block& b = blocks[p % blocks.size()];
+        for (unsigned c = 0; c < columns.size(); ++c){
+            b.values[c * blockRows + b.rows] = market.*(marketMetrics()[columns[c]].field);
+        }
+        b.rows ++;
+        if (b.rows == blockRows) handOver();
+    }
+
+    void handOver(){
+        filling = false;
+        published.fetch_add(1, memory_order_release);
+        wake.notify_one();
+    }
+
+    //writes what is left and waits for the flusher
+    void close(){
+        if (!file) return;
+        if (filling) handOver();
+        closing.store(true, memory_order_release);
+        wake.notify_one();
+        if (flusher.joinable()) flusher.join();
+        fclose(file);
+        file = 0;
+        if (dropped > 0){
+            fprintf(stderr, "market recorder dropped %llu samples\n", (unsigned long long)dropped);
+        }
+    }
+
+    //flushing thread
+    void flush(){
+        while (true){
+            uint64_t f = flushed.load(memory_order_relaxed);
+            if (f < published.load(memory_order_acquire)){
+                const Block& b = blocks[f % blocks.size()];
+                uint32_t s = stride;
+                fwrite(&b.rows, sizeof(b.rows), 1, file);
+                fwrite(&b.firstTick, sizeof(b.firstTick), 1, file);
+                fwrite(&s, sizeof(s), 1, file);
+                for (unsigned c = 0; c < columns.size(); ++c){
+                    fwrite(&b.values[c * blockRows], sizeof(float), b.rows, file);
+                }
+                flushed.store(f + 1, memory_order_release);
+                continue;
+            }
+            if (closing.load(memory_order_acquire)) break;
+            //the recorder does not lock to notify, so a wakeup can be missed;
+            //the timeout picks the block up anyway
+            unique_lock<mutex> lock(m);
+            wake.wait_for(lock, chrono::milliseconds(50));
+        }
+        fflush(file);
+    }
+
+    //reads a recording back into a csv table, false if it is not one
+    static bool exportCsv(const char* path, const char* csvPath){
+        FILE* in = fopen(path, "rb");
+        if (!in) return false;
+        uint32_t header[3];
+        if (fread(header, sizeof(uint32_t), 3, in) != 3 || memcmp(header, "MKTS", 4) != 0 || header[1] != VERSION){
+            fclose(in);
+            return false;
+        }
+        vector<string> names(header[2]);
+        for (string& name : names){
+            uint32_t length = 0;
+            if (fread(&length, sizeof(length), 1, in) != 1){
+                fclose(in);
+                return false;
+            }
+            name.resize(length);
+            if (length > 0 && fread(&name[0], 1, length, in) != length){
+                fclose(in);
+                return false;
+            }
+        }
+        FILE* out = fopen(csvPath, "w");
+        if (!out){
+            fclose(in);
+            return false;
+        }
+        fprintf(out, "tick");
+        for (const string& name : names) fprintf(out, ",%s", name.c_str());
+        fprintf(out, "\n");
+        vector<float> values;
+        uint32_t rows;
+        while (fread(&rows, sizeof(rows), 1, in) == 1){
+            uint64_t firstTick = 0;
+            uint32_t every = 1;
+            if (fread(&firstTick, sizeof(firstTick), 1, in) != 1) break;
+            if (fread(&every, sizeof(every), 1, in) != 1) break;
+            values.resize((size_t)rows * names.size());
+            if (fread(values.data(), sizeof(float), values.size(), in) != values.size()) break;
+            for (uint32_t r = 0; r < rows; ++r){
+                fprintf(out, "%llu", (unsigned long long)(firstTick + (uint64_t)r * every));
+                for (size_t c = 0; c < names.size(); ++c){
+                    fprintf(out, ",%g", values[c * rows + r]);
+                }
+                fprintf(out, "\n");
+            }
+        }
+        fclose(out);
+        fclose(in);
+        return true;
+    }
+};
+
+#endif
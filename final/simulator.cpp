@@ -4,7 +4,12 @@
 #include "helper.hpp"
 #include "agent_managers.hpp"
 #include "location_managers.hpp"
+#include "tick_schedule.hpp"
 #include "common.hpp"
+#include "voice_manager.hpp"
+#include "voice_pool.hpp"
+#include "spatial_cache.hpp"
+#include "audio_snapshot.hpp"
 #include "alloutil/al_AlloSphereAudioSpatializer.hpp"
 #include "alloutil/al_Simulator.hpp"
 #include "Cuttlebone/Cuttlebone.hpp"
@@ -20,6 +25,7 @@ using namespace std;
 #define BLOCK_SIZE 256
 #define SAMPLE_RATE 44100
 #define MAXIMUM_NUMBER_OF_SOUND_SOURCES (100)
+#define ACTIVE_VOICES (24)
 
 struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
     Material material;
@@ -35,6 +41,12 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
     Miner_Group miners;
     Worker_Union workers;
 
+    //who is where, rebuilt every tick for the agents' queries
+    WorldIndex world;
+
+    //the managers' calls of a tick, overlapped where they touch different data
+    TickSchedule schedule;
+
     //market manager
     MarketManager marketManager;
 
@@ -65,8 +77,19 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
     //Vbap* panner;
     Spatializer* panner;
     Listener* listener;
-    SoundSource *source[15];
-    SoundSource *sourceWorker[75];
+    SoundSource *source[ACTIVE_VOICES];
+    SoundSource capitalistLaw;  //attenuation of each kind, for the voices they get
+    SoundSource workerLaw;
+    VoiceManager voiceManager;  //candidates are the capitalists, then the workers
+    VoiceBlocks voiceBlocks;
+    VoiceBlocks fadeBlocks;
+    VoicePool voicePool;        //renders the voices' blocks side by side
+    unsigned numFrames;         //of the block being rendered
+    Vec3f ear;                  //the listener for the block being rendered
+    AgentSound sound;           //the agents as the audio needs them, captured after each tick
+    ControlChannel<AgentSound> soundChannel;
+    const AgentSound* heard;    //the capture the block being rendered plays
+    SpatialCache spatialCache;  //the voices' speaker gains, the scene's panning without the per-block work
 
     MyApp() : maker(Simulator::defaultBroadcastIP()),
         InterfaceServerClient(Simulator::defaultInterfaceServerIP()), vbap_scene(BLOCK_SIZE)       {
@@ -126,27 +149,34 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
         float near = 0.2;
         float listenRadius = 24;
 
-        //load audio source, capitalists first
-        for (unsigned i = 0; i < capitalists.cs.size(); ++i) {
+        //attenuation of each kind
+        capitalistLaw.nearClip(near);
+        capitalistLaw.farClip(listenRadius);
+        capitalistLaw.law(ATTEN_LINEAR);
+        //capitalistLaw.law(ATTEN_INVERSE_SQUARE);
+        workerLaw.nearClip(near);
+        workerLaw.farClip(listenRadius * 0.75);
+        workerLaw.law(ATTEN_LINEAR);
+
+        //a fixed set of voices, handed to the most audible agents; the
+        //sources keep where each voice is and how it attenuates, the
+        //spatial cache pans them over the layout instead of the scene
+        for (unsigned i = 0; i < ACTIVE_VOICES; ++i) {
             source[i] = new SoundSource();
             source[i]->nearClip(near);
             source[i]->farClip(listenRadius);
             source[i]->law(ATTEN_LINEAR);
-            //source[i]->law(ATTEN_INVERSE_SQUARE);
             source[i]->dopplerType(DOPPLER_NONE); // XXX doppler kills when moving fast!
-            //source[i].law(ATTEN_INVERSE);
-            vbap_scene.addSource(*source[i]);
-        }
-         for (unsigned i = 0; i < workers.workers.size(); ++i) {
-            sourceWorker[i] = new SoundSource();
-            sourceWorker[i]->nearClip(near);
-            sourceWorker[i]->farClip(listenRadius * 0.75);
-            sourceWorker[i]->law(ATTEN_LINEAR);
-            //source[i]->law(ATTEN_INVERSE_SQUARE);
-            sourceWorker[i]->dopplerType(DOPPLER_NONE); // XXX doppler kills when moving fast!
-            //source[i].law(ATTEN_INVERSE);
-            vbap_scene.addSource(*sourceWorker[i]);
         }
+        spatialCache.speakers(*speakerLayout);
+        spatialCache.resize(ACTIVE_VOICES);
+        voiceManager.reserve(ACTIVE_VOICES, capitalists.cs.size() + workers.workers.size());
+        voiceBlocks.resize(ACTIVE_VOICES, BLOCK_SIZE);
+        fadeBlocks.resize(ACTIVE_VOICES, BLOCK_SIZE);
+        //half the cores, the tick and the graphics have the rest
+        voicePool.resize(max(1u, thread::hardware_concurrency() / 2));
+        numFrames = BLOCK_SIZE;
+        heard = 0;
         
         vbap_scene.usePerSampleProcessing(false);
         AlloSphereAudioSpatializer::initAudio("ECHO X5", 44100, BLOCK_SIZE, 60, 60);
@@ -157,6 +187,7 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
         metropolis.generate(capitalists);
         marketManager.statsInit(capitalists, workers, miners);
         workers.initID();
+        schedule.declare(marketManager, metropolis, factories, NaturalResourcePts, capitalists, miners, workers, world);
 
         
     }
@@ -168,68 +199,27 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
 
         }
 
-        //market
-        marketManager.populationMonitor(capitalists, workers, miners, factories.fs);
-        marketManager.capitalMonitor(capitalists, workers, miners, factories.fs);
-        marketManager.updatePrice(capitalists, workers, miners);
-        
-        //related to market
-        factories.getLaborPrice(marketManager);
-        miners.calculateResourceUnitPrice(factories.fs);
-
-        //locations
-        metropolis.run();
-        factories.run(capitalists);
-        NaturalResourcePts.run();
-
-        //agents
-        capitalists.run(metropolis.mbs);
-        miners.run(NaturalResourcePts.nrps, miners.ms, capitalists.cs);
-        workers.run(factories.fs, workers.workers, capitalists.cs);
-        
-        //interaction between groups
-        NaturalResourcePts.checkMinerPick(miners.ms);
-        factories.checkWorkerNum(workers.workers);
-        metropolis.mapCapitalistStats(capitalists.cs);
-        capitalists.getResource(miners.ms);
-        capitalists.getWorkersPaymentStats(factories.fs);
-
-        //pay workers
-        factories.payWorkers(marketManager);
-       
-        //locational behaviors
-        factories.drawLinks(capitalists);
+        //market, locations, agents and the interaction between groups,
+        //in the order declared in tick_schedule.hpp
+        schedule.run();
 
         //camera
         if (cameraSwitch == 1){
-            nav().pos() = capitalists.cs[0].pose.pos() + Vec3f(0,0,-4);
+            nav().pos() = capitalists.store.kinematics.position[0] + Vec3f(0,0,-4);
             //nav().faceToward(capitalists.cs[0].movingTarget, 0.3*dt);
         } else if (cameraSwitch == 2) {
-            nav().pos() = workers.workers[0].pose.pos()+ Vec3f(0,0,-4);
+            nav().pos() = workers.store.kinematics.position[0]+ Vec3f(0,0,-4);
             //nav().faceToward(factories.fs[workers.workers[0].id_ClosestFactory].position, 0.3*dt);
         } else if (cameraSwitch == 3) {
-            nav().pos() = miners.ms[0].pose.pos() + Vec3f(0,0,-4);
+            nav().pos() = miners.store.kinematics.position[0] + Vec3f(0,0,-4);
             //nav().faceToward(NaturalResourcePts.nrps[miners.ms[0].id_ClosestNRP].position, 0.3 * dt);
         } else {
             
         }
-        //audio source position
-        //capitlist sound position
-        for (int i = 0; i < capitalists.cs.size(); i++){
-            source[i]->pos(capitalists.cs[i].pose.pos().x,capitalists.cs[i].pose.pos().y, capitalists.cs[i].pose.pos().z);
-                //double d = (source[i].pos() - listener->pos()).mag();
-                //double a = source[i].attenuation(d);
-                //double db = log10(a) * 20.0;
-                //cout << d << "," << a << "," << db << endl;
-        }
-        //worker sound position
-        for (int i = 0; i < workers.workers.size(); i++){
-            sourceWorker[i]->pos(workers.workers[i].pose.pos().x,workers.workers[i].pose.pos().y, workers.workers[i].pose.pos().z);
-                //double d = (source[i].pos() - listener->pos()).mag();
-                //double a = source[i].attenuation(d);
-                //double db = log10(a) * 20.0;
-                //cout << d << "," << a << "," << db << endl;
-        }
+
+        //what the audio thread plays until the next tick
+        sound.capture(capitalists, workers, nav().pos());
+        soundChannel.publish(sound);
 
         //debug
         // cout << workers[0].id_ClosestFactory << " i m heading to " << endl;
@@ -255,28 +245,28 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
         state.phase = phase;
 
         for (int i = 0; i < miners.ms.size(); i ++){
-            state.miner_pose[i] = miners.ms[i].pose;
-            state.miner_scale[i] = miners.ms[i].scaleFactor;
-            state.miner_poetryHoldings[i] = miners.ms[i].poetryHoldings;
-            state.miner_bankrupted[i] = miners.ms[i].bankrupted();
+            state.miner_pose[i] = Pose(miners.store.kinematics.position[i], miners.store.kinematics.orientation[i]);
+            state.miner_scale[i] = miners.store.traits.scaleFactor;
+            state.miner_poetryHoldings[i] = miners.store.ledger.poetryHoldings[i];
+            state.miner_bankrupted[i] = miners.store.bankrupted(i);
             state.miner_fullpack[i] = miners.ms[i].fullpack;
             state.miner_lines_posA[i] = miners.lines[i].vertices()[0];
             state.miner_lines_posB[i] = miners.lines[i].vertices()[1];
     
         }
         for (int i = 0; i < workers.workers.size(); i ++){
-            state.worker_pose[i] = workers.workers[i].pose;
-            state.worker_scale[i] = workers.workers[i].scaleFactor;
-            state.worker_poetryHoldings[i] = workers.workers[i].poetryHoldings;
-            state.worker_bankrupted[i] = workers.workers[i].bankrupted();
+            state.worker_pose[i] = Pose(workers.store.kinematics.position[i], workers.store.kinematics.orientation[i]);
+            state.worker_scale[i] = workers.store.traits.scaleFactor;
+            state.worker_poetryHoldings[i] = workers.store.ledger.poetryHoldings[i];
+            state.worker_bankrupted[i] = workers.store.bankrupted(i);
             state.worker_lines_posA[i] = workers.lines[i].vertices()[0];
             state.worker_lines_posB[i] = workers.lines[i].vertices()[1];
         }
         for (int i = 0; i < capitalists.cs.size(); i ++){
-            state.capitalist_pose[i] = capitalists.cs[i].pose;
-            state.capitalist_scale[i] = capitalists.cs[i].scaleFactor;
-            state.capitalist_poetryHoldigs[i] = capitalists.cs[i].poetryHoldings;
-            state.capitalist_bankrupted[i] = capitalists.cs[i].bankrupted();
+            state.capitalist_pose[i] = Pose(capitalists.store.kinematics.position[i], capitalists.store.kinematics.orientation[i]);
+            state.capitalist_scale[i] = capitalists.store.traits.scaleFactor;
+            state.capitalist_poetryHoldigs[i] = capitalists.store.ledger.poetryHoldings[i];
+            state.capitalist_bankrupted[i] = capitalists.store.bankrupted(i);
             state.capitalist_lines_posA[i] = factories.lines[i].vertices()[0];
             state.capitalist_lines_posB[i] = factories.lines[i].vertices()[1];
             state.factory_pos[i] = factories.fs[i].position;
@@ -346,45 +336,119 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
         }
 
     }
+    //silence for what came out as nan
+    static void scrub(float* block, unsigned numFrames){
+        for (unsigned k = 0; k < numFrames; ++k){
+            if (isnan(block[k])) block[k] = 0; // XXX need this nan check?
+        }
+    }
+    //how loud a candidate would arrive at the listener
+    float audibility(unsigned c){
+        unsigned numCapitalists = heard->capitalistPosition.size();
+        if (c < numCapitalists){
+            int voice = heard->capitalistVoice[c];
+            if (voice < 0) return 0;
+            float d = (heard->capitalistPosition[c] - ear).mag();
+            return capitalistLaw.attenuation(d) * capitalists.voices[voice].loudness();
+        }
+        unsigned i = c - numCapitalists;
+        int voice = heard->workerVoice[i];
+        if (voice < 0) return 0;
+        float d = (heard->workerPosition[i] - ear).mag();
+        return workerLaw.attenuation(d) * workers.voices[voice].loudness();
+    }
+    //silence for one that lost its voice since it was chosen
+    void renderCandidate(unsigned c, float* block, unsigned numFrames){
+        unsigned numCapitalists = heard->capitalistPosition.size();
+        int voice = c < numCapitalists ? heard->capitalistVoice[c] : heard->workerVoice[c - numCapitalists];
+        if (voice < 0){
+            fill(block, block + numFrames, 0.0f);
+        } else if (c < numCapitalists){
+            capitalists.voices[voice].render(block, numFrames);
+        } else {
+            workers.voices[voice].render(block, numFrames);
+        }
+    }
+    void place(SoundSource& s, unsigned c){
+        unsigned numCapitalists = heard->capitalistPosition.size();
+        const SoundSource& law = c < numCapitalists ? capitalistLaw : workerLaw;
+        const Vec3f& p = c < numCapitalists ? heard->capitalistPosition[c]
+                                             : heard->workerPosition[c - numCapitalists];
+        s.pos(p.x, p.y, p.z);
+        s.farClip(law.farClip());
+    }
+    //one voice's block and its gains, on whichever thread of the pool takes it
+    void renderSlot(unsigned v){
+        const VoiceManager::Slot& slot = voiceManager.slots[v];
+        float* block = voiceBlocks[v];
+        if (slot.candidate != VoiceManager::NONE){
+            place(*source[v], slot.candidate);
+            if (slot.fresh) spatialCache.invalidate(v);
+            renderCandidate(slot.candidate, block, numFrames);
+            if (slot.fading != VoiceManager::NONE){
+                //the one going keeps its own block, it is mixed where it was
+                float* going = fadeBlocks[v];
+                renderCandidate(slot.fading, going, numFrames);
+                ramp(going, numFrames, 1, 0);
+                scrub(going, numFrames);
+            }
+            if (slot.fresh) ramp(block, numFrames, 0, 1);
+        } else if (slot.fading != VoiceManager::NONE){
+            renderCandidate(slot.fading, block, numFrames);
+            ramp(block, numFrames, 1, 0);
+        } else {
+            return;
+        }
+        scrub(block, numFrames);
+        spatialCache.aim(v, *source[v], ear);
+    }
     virtual void onSound(AudioIOData& io) {
         gam::Sync::master().spu(AlloSphereAudioSpatializer::audioIO().fps());
         
-        float x = nav().pos().x;
-        float y = nav().pos().y;
-        float z = nav().pos().z;
-        listener->pos(x,y,z);
-
-        
+        //the last tick the simulation published, nothing else of it is read here
+        heard = &soundChannel.read();
+        ear = heard->ear;
+        listener->pos(ear.x, ear.y, ear.z);
+        for (unsigned i = 0; i < heard->workerVoice.size(); ++i){
+            if (heard->workerVoice[i] >= 0){
+                workers.voices[heard->workerVoice[i]].noiseLevel = heard->workerNoise[i];
+            }
+        }
 
-        int numFrames = io.framesPerBuffer();
-        for (int k = 0; k < numFrames; k++) {
-            //capitalist sample
-            for (int i = 0; i < capitalists.cs.size(); i++) {
-                //io.frame(0);
-                float f = 0;
-                f = capitalists.cs[i].onProcess(io);
-                double d = isnan(f) ? 0.0 : (double)f; // XXX need this nan check?
-                source[i]->writeSample(d);
-                io.frame(0);
+        //the most audible agents get the voices, the rest are not rendered
+        voiceManager.candidates(heard->candidates());
+        for (unsigned c = 0; c < voiceManager.numCandidates; ++c){
+            voiceManager.score[c] = audibility(c);
+        }
+        voiceManager.choose();
+
+        //every voice renders the whole block into its own buffer and works
+        //out its speaker gains if it moved, all of them at once over the pool
+        numFrames = min<unsigned>(io.framesPerBuffer(), BLOCK_SIZE);
+        auto renderVoice = [this](unsigned v){ renderSlot(v); };
+        voicePool.run(renderVoice, ACTIVE_VOICES);
+
+        //then into the speakers, ramping each voice's gains across the block.
+        //when a voice changed hands the one going fades out at the gains it
+        //had and the one coming fades in at its own
+        for (unsigned v = 0; v < ACTIVE_VOICES; ++v){
+            const VoiceManager::Slot& slot = voiceManager.slots[v];
+            if (slot.candidate != VoiceManager::NONE && slot.fading != VoiceManager::NONE){
+                spatialCache.mixLast(v, fadeBlocks[v], numFrames, io);
             }
-            //worker sample
-            for (int i = 0; i < workers.workers.size(); i ++){
-                float f = 0;
-                f = workers.workers[i].onProcess(io);
-                double d = isnan(f) ? 0.0 : (double)f;
-                sourceWorker[i]->writeSample(d);
-                io.frame(0);
+            if (slot.fresh) spatialCache.jump(v);
+            if (slot.candidate != VoiceManager::NONE || slot.fading != VoiceManager::NONE){
+                spatialCache.mix(v, voiceBlocks[v], numFrames, io);
             }
         }
-        //io.frame(0);
-        
-        vbap_scene.render(io);        
+        voiceManager.settle();
     }
     void onKeyDown(const ViewpointWindow&, const Keyboard& k) {
         switch(k.key()){
             case '7': factories.drawingLinks = !factories.drawingLinks; break;
             case '8': miners.drawingLinks = !miners.drawingLinks; break;
             case '9': workers.drawingLinks = !workers.drawingLinks;break;
+            case 'p': schedule.graph.report(cout); break;
             case '1': renderModeSwitch = 1; break;
             case '2': renderModeSwitch = 2; break;
             case '3': renderModeSwitch = 3; break;
@@ -29,6 +29,9 @@ struct MyApp : App {
     Miner_Group miners;
     Worker_Union workers;
 
+    //who is where, rebuilt every tick for the agents' queries
+    WorldIndex world;
+
     //market manager
     MarketManager marketManager;
 
@@ -68,14 +71,15 @@ struct MyApp : App {
         NaturalResourcePts.run();
 
         //agents
-        capitalists.run(metropolis.mbs);
-        miners.run(NaturalResourcePts.nrps, miners.ms, capitalists.cs);
-        workers.run(factories.fs, workers.workers, capitalists.cs);
+        world.build(miners.store, workers.store, capitalists.store, factories.fs, NaturalResourcePts.nrps, metropolis.mbs);
+        capitalists.run(world, metropolis.mbs);
+        miners.run(world, NaturalResourcePts.nrps, capitalists.cs);
+        workers.run(world, factories.fs, capitalists.cs);
         
         //interaction between groups
         NaturalResourcePts.checkMinerPick(miners.ms);
         factories.checkWorkerNum(workers.workers);
-        metropolis.mapCapitalistStats(capitalists.cs);
+        metropolis.mapCapitalistStats(capitalists);
         capitalists.getResource(miners.ms);
         capitalists.getWorkersPaymentStats(factories.fs);
 
@@ -108,28 +112,28 @@ struct MyApp : App {
         state.numResources = NaturalResourcePts.nrps.size() * 7;
 
         for (int i = 0; i < miners.ms.size(); i ++){
-            state.miner_pose[i] = miners.ms[i].pose;
-            state.miner_scale[i] = miners.ms[i].scaleFactor;
-            state.miner_poetryHoldings[i] = miners.ms[i].poetryHoldings;
-            state.miner_bankrupted[i] = miners.ms[i].bankrupted();
+            state.miner_pose[i] = Pose(miners.store.kinematics.position[i], miners.store.kinematics.orientation[i]);
+            state.miner_scale[i] = miners.store.traits.scaleFactor;
+            state.miner_poetryHoldings[i] = miners.store.ledger.poetryHoldings[i];
+            state.miner_bankrupted[i] = miners.store.bankrupted(i);
             state.miner_fullpack[i] = miners.ms[i].fullpack;
             state.miner_lines_posA[i] = miners.lines[i].vertices()[0];
             state.miner_lines_posB[i] = miners.lines[i].vertices()[1];
     
         }
         for (int i = 0; i < workers.workers.size(); i ++){
-            state.worker_pose[i] = workers.workers[i].pose;
-            state.worker_scale[i] = workers.workers[i].scaleFactor;
-            state.worker_poetryHoldings[i] = workers.workers[i].poetryHoldings;
-            state.worker_bankrupted[i] = workers.workers[i].bankrupted();
+            state.worker_pose[i] = Pose(workers.store.kinematics.position[i], workers.store.kinematics.orientation[i]);
+            state.worker_scale[i] = workers.store.traits.scaleFactor;
+            state.worker_poetryHoldings[i] = workers.store.ledger.poetryHoldings[i];
+            state.worker_bankrupted[i] = workers.store.bankrupted(i);
             state.worker_lines_posA[i] = workers.lines[i].vertices()[0];
             state.worker_lines_posB[i] = workers.lines[i].vertices()[1];
         }
         for (int i = 0; i < capitalists.cs.size(); i ++){
-            state.capitalist_pose[i] = capitalists.cs[i].pose;
-            state.capitalist_scale[i] = capitalists.cs[i].scaleFactor;
-            state.capitalist_poetryHoldigs[i] = capitalists.cs[i].poetryHoldings;
-            state.capitalist_bankrupted[i] = capitalists.cs[i].bankrupted();
+            state.capitalist_pose[i] = Pose(capitalists.store.kinematics.position[i], capitalists.store.kinematics.orientation[i]);
+            state.capitalist_scale[i] = capitalists.store.traits.scaleFactor;
+            state.capitalist_poetryHoldigs[i] = capitalists.store.ledger.poetryHoldings[i];
+            state.capitalist_bankrupted[i] = capitalists.store.bankrupted(i);
             state.capitalist_lines_posA[i] = factories.lines[i].vertices()[0];
             state.capitalist_lines_posB[i] = factories.lines[i].vertices()[1];
             state.factory_pos[i] = factories.fs[i].position;
@@ -5,6 +5,7 @@
 #include "agent_managers.hpp"
 #include "location_managers.hpp"
 #include "common.hpp"
+#include "audio_snapshot.hpp"
 #include "alloutil/al_AlloSphereAudioSpatializer.hpp"
 #include "alloutil/al_AlloSphereSpeakerLayout.hpp"
 #include "allocore/sound/al_Vbap.hpp"
@@ -35,6 +36,9 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
     Miner_Group miners;
     Worker_Union workers;
 
+    //who is where, rebuilt every tick for the agents' queries
+    WorldIndex world;
+
     //market manager
     MarketManager marketManager;
 
@@ -60,6 +64,8 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
     Spatializer* panner;
     Listener* listener;
     SoundSource *source[MAXIMUM_NUMBER_OF_SOUND_SOURCES];
+    AgentSound sound;           //the agents as the audio needs them, captured after each tick
+    ControlChannel<AgentSound> soundChannel;
 
     MyApp() : maker(Simulator::defaultBroadcastIP()),
         InterfaceServerClient(Simulator::defaultInterfaceServerIP()), vbap_scene(BLOCK_SIZE)        {
@@ -219,14 +225,15 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
         NaturalResourcePts.run();
 
         //agents
-        capitalists.run(metropolis.mbs);
-        miners.run(NaturalResourcePts.nrps, miners.ms, capitalists.cs);
-        workers.run(factories.fs, workers.workers, capitalists.cs);
+        world.build(miners.store, workers.store, capitalists.store, factories.fs, NaturalResourcePts.nrps, metropolis.mbs);
+        capitalists.run(world, metropolis.mbs);
+        miners.run(world, NaturalResourcePts.nrps, capitalists.cs);
+        workers.run(world, factories.fs, capitalists.cs);
         
         //interaction between groups
         NaturalResourcePts.checkMinerPick(miners.ms);
         factories.checkWorkerNum(workers.workers);
-        metropolis.mapCapitalistStats(capitalists.cs);
+        metropolis.mapCapitalistStats(capitalists);
         capitalists.getResource(miners.ms);
         capitalists.getWorkersPaymentStats(factories.fs);
 
@@ -238,18 +245,22 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
 
         //camera
         if (cameraSwitch == 1){
-            nav().pos() = capitalists.cs[0].pose.pos() + Vec3f(0,0,-4);
+            nav().pos() = capitalists.store.kinematics.position[0] + Vec3f(0,0,-4);
             //nav().faceToward(capitalists.cs[0].movingTarget, 0.3*dt);
         } else if (cameraSwitch == 2) {
-            nav().pos() = workers.workers[0].pose.pos()+ Vec3f(0,0,-4);
+            nav().pos() = workers.store.kinematics.position[0]+ Vec3f(0,0,-4);
             //nav().faceToward(factories.fs[workers.workers[0].id_ClosestFactory].position, 0.3*dt);
         } else if (cameraSwitch == 3) {
-            nav().pos() = miners.ms[0].pose.pos() + Vec3f(0,0,-4);
+            nav().pos() = miners.store.kinematics.position[0] + Vec3f(0,0,-4);
             //nav().faceToward(NaturalResourcePts.nrps[miners.ms[0].id_ClosestNRP].position, 0.3 * dt);
         } else {
             
         }
 
+        //what the audio thread plays until the next tick
+        sound.capture(capitalists, workers, nav().pos());
+        soundChannel.publish(sound);
+
         //debug
         // cout << workers[0].id_ClosestFactory << " i m heading to " << endl;
         // cout << workers[0].distToClosestFactory << " this much far " << endl;
@@ -274,28 +285,28 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
         state.phase = phase;
 
         for (int i = 0; i < miners.ms.size(); i ++){
-            state.miner_pose[i] = miners.ms[i].pose;
-            state.miner_scale[i] = miners.ms[i].scaleFactor;
-            state.miner_poetryHoldings[i] = miners.ms[i].poetryHoldings;
-            state.miner_bankrupted[i] = miners.ms[i].bankrupted();
+            state.miner_pose[i] = Pose(miners.store.kinematics.position[i], miners.store.kinematics.orientation[i]);
+            state.miner_scale[i] = miners.store.traits.scaleFactor;
+            state.miner_poetryHoldings[i] = miners.store.ledger.poetryHoldings[i];
+            state.miner_bankrupted[i] = miners.store.bankrupted(i);
             state.miner_fullpack[i] = miners.ms[i].fullpack;
             state.miner_lines_posA[i] = miners.lines[i].vertices()[0];
             state.miner_lines_posB[i] = miners.lines[i].vertices()[1];
     
         }
         for (int i = 0; i < workers.workers.size(); i ++){
-            state.worker_pose[i] = workers.workers[i].pose;
-            state.worker_scale[i] = workers.workers[i].scaleFactor;
-            state.worker_poetryHoldings[i] = workers.workers[i].poetryHoldings;
-            state.worker_bankrupted[i] = workers.workers[i].bankrupted();
+            state.worker_pose[i] = Pose(workers.store.kinematics.position[i], workers.store.kinematics.orientation[i]);
+            state.worker_scale[i] = workers.store.traits.scaleFactor;
+            state.worker_poetryHoldings[i] = workers.store.ledger.poetryHoldings[i];
+            state.worker_bankrupted[i] = workers.store.bankrupted(i);
             state.worker_lines_posA[i] = workers.lines[i].vertices()[0];
             state.worker_lines_posB[i] = workers.lines[i].vertices()[1];
         }
         for (int i = 0; i < capitalists.cs.size(); i ++){
-            state.capitalist_pose[i] = capitalists.cs[i].pose;
-            state.capitalist_scale[i] = capitalists.cs[i].scaleFactor;
-            state.capitalist_poetryHoldigs[i] = capitalists.cs[i].poetryHoldings;
-            state.capitalist_bankrupted[i] = capitalists.cs[i].bankrupted();
+            state.capitalist_pose[i] = Pose(capitalists.store.kinematics.position[i], capitalists.store.kinematics.orientation[i]);
+            state.capitalist_scale[i] = capitalists.store.traits.scaleFactor;
+            state.capitalist_poetryHoldigs[i] = capitalists.store.ledger.poetryHoldings[i];
+            state.capitalist_bankrupted[i] = capitalists.store.bankrupted(i);
             state.capitalist_lines_posA[i] = factories.lines[i].vertices()[0];
             state.capitalist_lines_posB[i] = factories.lines[i].vertices()[1];
             state.factory_pos[i] = factories.fs[i].position;
@@ -355,13 +366,15 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
     }
     virtual void onSound(AudioIOData& io) {
         gam::Sync::master().spu(AlloSphereAudioSpatializer::audioIO().fps());
-        float x = nav().pos().x;
-        float y = nav().pos().y;
-        float z = nav().pos().z;
+        //the last tick the simulation published, not the agents themselves
+        const AgentSound& heard = soundChannel.read();
+        float x = heard.ear.x;
+        float y = heard.ear.y;
+        float z = heard.ear.z;
 
         //vector<unsigned> n;
-        for (int i = 0; i < capitalists.cs.size(); i++){
-            source[i]->pos(capitalists.cs[i].pose.pos().x,capitalists.cs[i].pose.pos().y, capitalists.cs[i].pose.pos().z);
+        for (int i = 0; i < heard.capitalistPosition.size(); i++){
+            source[i]->pos(heard.capitalistPosition[i].x, heard.capitalistPosition[i].y, heard.capitalistPosition[i].z);
         //double d = (source[i].pos() - listener->pos()).mag();
         //double a = source[i].attenuation(d);
         //double db = log10(a) * 20.0;
@@ -372,7 +385,7 @@ struct MyApp : App, AlloSphereAudioSpatializer, InterfaceServerClient {
         listener->pos(x, y, z);
         int numFrames = io.framesPerBuffer();
         for (int k = 0; k < numFrames; k++) {
-            for (int i = 0; i < capitalists.cs.size(); i++) {
+            for (int i = 0; i < heard.capitalistPosition.size(); i++) {
                     //io.frame(0);
                     float f = 0;
                     f = capitalists.cs[i].v_player();
@@ -0,0 +1,244 @@
+#ifndef INCLUDE_SPATIAL_CACHE_HPP
+#define INCLUDE_SPATIAL_CACHE_HPP
+
+#include <vector>
+#include <cmath>
+#include "allocore/io/al_App.hpp"
+#include "alloutil/al_AlloSphereAudioSpatializer.hpp"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+using namespace al;
+using namespace std;
+
+//speaker gains of every source, worked out again only when it has moved
+//a source is panned between at most TAPS speakers (vbap's triangle, a pair
+//on a ring or in stereo) with its attenuation folded in. aim() recomputes
+//them once the source's position relative to the listener has drifted more
+//than tolerance of its distance (about a degree and 2% of the distance at
+//the default), otherwise the last ones stand. mix() ramps from the gains of
+//the last block to the new ones across the block, multiply-adding the
+//source's block into the buses of the speakers it touches and no others.
+struct SpatialCache{
+    enum { TAPS = 3 };
+
+    struct Gains{
+        unsigned channel[TAPS];
+        float gain[TAPS];
+        unsigned n;
+    };
+
+    struct Entry{
+        Vec3f relative;     //where the gains were worked out for
+        bool valid;
+        Gains target;
+        Gains applied;      //as the last block ended
+        unsigned recomputed;    //times its gains were worked out, for profiling
+    };
+
+    vector<Vec3f> directions;   //unit vectors of the speakers, x left, y front, z up
+    vector<unsigned> channels;  //their device channels
+    vector<Entry> entries;
+    float tolerance;
+
+    SpatialCache(){
+        tolerance = 0.02;
+    }
+
+    void speakers(const SpeakerLayout& layout){
+        directions.clear();
+        channels.clear();
+        for (const Speaker& s : layout.speakers()){
+            Vec3d v = s.vec();
+            directions.push_back(Vec3f(v.x, v.y, v.z).normalize());
+            channels.push_back(s.deviceChannel);
+        }
+    }
+
+    void resize(unsigned sources){
+        entries.resize(sources);
+        for (unsigned s = 0; s < sources; ++s){
+            entries[s].valid = false;
+            entries[s].target.n = 0;
+            entries[s].applied.n = 0;
+            entries[s].recomputed = 0;
+        }
+    }
+
+    //gain sets worked out over all sources; aim() runs on the pool's
+    //threads, so each source counts its own and they add up here
+    unsigned recomputed() const {
+        unsigned n = 0;
+        for (const Entry& e : entries) n += e.recomputed;
+        return n;
+    }
+
+    void invalidate(unsigned s){
+        entries[s].valid = false;
+    }
+
+    //the source's gains for this block
+    void aim(unsigned s, SoundSource& source, const Vec3f& ear){
+        Entry& e = entries[s];
+        const Vec3d& p = source.pos();
+        Vec3f relative(p.x - ear.x, p.y - ear.y, p.z - ear.z);
+        float distance = relative.mag();
+        if (e.valid && (relative - e.relative).mag() <= tolerance * distance + 1e-4f) return;
+        e.relative = relative;
+        e.valid = true;
+        //from the app's frame (x right, y up, z back) into the speakers'
+        Vec3f direction = distance > 0 ? Vec3f(-relative.x, -relative.z, relative.y) / distance : Vec3f(0, 1, 0);
+        pan(direction, (float)source.attenuation(distance), e.target);
+        e.recomputed++;
+    }
+
+    //vbap between the speakers around direction: the triangle of the
+    //closest ones that holds it, else the pair around it on the horizon
+    void pan(const Vec3f& direction, float attenuation, Gains& out) const {
+        out.n = 0;
+        unsigned numSpeakers = directions.size();
+        if (numSpeakers == 0 || attenuation <= 0) return;
+
+        //the closest few, the triangle is among them
+        const unsigned NEAREST = 8;
+        unsigned nearest[NEAREST];
+        float closeness[NEAREST];
+        unsigned m = 0;
+        for (unsigned i = 0; i < numSpeakers; ++i){
+            float c = directions[i].dot(direction);
+            unsigned k = m < NEAREST ? m++ : NEAREST;
+            if (k == NEAREST && c <= closeness[NEAREST - 1]) continue;
+            if (k == NEAREST) k = NEAREST - 1;
+            while (k > 0 && closeness[k - 1] < c){
+                nearest[k] = nearest[k - 1];
+                closeness[k] = closeness[k - 1];
+                k--;
+            }
+            nearest[k] = i;
+            closeness[k] = c;
+        }
+
+        float best = -4;
+        for (unsigned a = 0; a < m; ++a){
+            for (unsigned b = a + 1; b < m; ++b){
+                for (unsigned c = b + 1; c < m; ++c){
+                    const Vec3f& la = directions[nearest[a]];
+                    const Vec3f& lb = directions[nearest[b]];
+                    const Vec3f& lc = directions[nearest[c]];
+                    Vec3f bc = lb.cross(lc);
+                    float det = la.dot(bc);
+                    if (fabs(det) < 1e-4f) continue;
+                    float g[3] = { direction.dot(bc) / det, direction.dot(lc.cross(la)) / det,
+                                   direction.dot(la.cross(lb)) / det };
+                    if (g[0] < -1e-4f || g[1] < -1e-4f || g[2] < -1e-4f) continue;
+                    //of the triangles holding it, the one of the closest speakers
+                    float close = closeness[a] + closeness[b] + closeness[c];
+                    if (close <= best) continue;
+                    best = close;
+                    float power = sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+                    unsigned abc[3] = { nearest[a], nearest[b], nearest[c] };
+                    out.n = 3;
+                    for (unsigned t = 0; t < 3; ++t){
+                        out.channel[t] = channels[abc[t]];
+                        out.gain[t] = max(g[t], 0.0f) / power * attenuation;
+                    }
+                }
+            }
+        }
+        if (out.n > 0) return;
+
+        //a ring, stereo, or outside every triangle: the two closest on the horizon
+        if (m == 1){
+            out.n = 1;
+            out.channel[0] = channels[nearest[0]];
+            out.gain[0] = attenuation;
+            return;
+        }
+        Vec3f la = directions[nearest[0]];
+        Vec3f lb = directions[nearest[1]];
+        float det = la.x * lb.y - la.y * lb.x;
+        float g[2] = { 1, 0 };
+        if (fabs(det) > 1e-4f){
+            g[0] = max(0.0f, (direction.x * lb.y - direction.y * lb.x) / det);
+            g[1] = max(0.0f, (la.x * direction.y - la.y * direction.x) / det);
+        }
+        float power = sqrt(g[0] * g[0] + g[1] * g[1]);
+        if (power <= 0){
+            g[0] = 1;
+            power = 1;
+        }
+        out.n = 2;
+        for (unsigned t = 0; t < 2; ++t){
+            out.channel[t] = channels[nearest[t]];
+            out.gain[t] = g[t] / power * attenuation;
+        }
+    }
+
+    //the block into the buses, ramping every touched speaker from its old gain to its new one
+    void mix(unsigned s, const float* block, unsigned frames, AudioIOData& io){
+        Entry& e = entries[s];
+        unsigned buses = io.channelsOut();
+        for (unsigned t = 0; t < e.target.n; ++t){
+            float from = 0;
+            for (unsigned u = 0; u < e.applied.n; ++u){
+                if (e.applied.channel[u] == e.target.channel[t]) from = e.applied.gain[u];
+            }
+            if (e.target.channel[t] < buses){
+                multiplyAdd(io.outBuffer(e.target.channel[t]), block, frames, from, e.target.gain[t]);
+            }
+        }
+        //speakers it left fade out
+        for (unsigned u = 0; u < e.applied.n; ++u){
+            bool kept = false;
+            for (unsigned t = 0; t < e.target.n; ++t){
+                if (e.applied.channel[u] == e.target.channel[t]) kept = true;
+            }
+            if (!kept && e.applied.channel[u] < buses){
+                multiplyAdd(io.outBuffer(e.applied.channel[u]), block, frames, e.applied.gain[u], 0);
+            }
+        }
+        e.applied = e.target;
+    }
+
+    //the gains start where they are aimed, no ramp from whoever held the
+    //source before; for a voice that comes in fading up on its own
+    void jump(unsigned s){
+        entries[s].applied = entries[s].target;
+    }
+
+    //the block at the gains the last block ended with, for the voice fading
+    //out of a source that another one took over; before that one's mix()
+    void mixLast(unsigned s, const float* block, unsigned frames, AudioIOData& io){
+        const Entry& e = entries[s];
+        unsigned buses = io.channelsOut();
+        for (unsigned u = 0; u < e.applied.n; ++u){
+            if (e.applied.channel[u] < buses){
+                multiplyAdd(io.outBuffer(e.applied.channel[u]), block, frames, e.applied.gain[u], e.applied.gain[u]);
+            }
+        }
+    }
+
+    //out += in * a gain going linearly from `from` to `to` over the block
+    static void multiplyAdd(float* out, const float* in, unsigned frames, float from, float to){
+        if (from == 0 && to == 0) return;
+        float step = frames > 0 ? (to - from) / frames : 0;
+        unsigned k = 0;
+#if defined(__SSE__) || defined(_M_X64)
+        __m128 g = _mm_set_ps(from + 4 * step, from + 3 * step, from + 2 * step, from + step);
+        __m128 dg = _mm_set1_ps(4 * step);
+        for (; k + 4 <= frames; k += 4){
+            __m128 o = _mm_loadu_ps(out + k);
+            o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(in + k), g));
+            _mm_storeu_ps(out + k, o);
+            g = _mm_add_ps(g, dg);
+        }
+#endif
+        for (; k < frames; ++k){
+            out[k] += in[k] * (from + (k + 1) * step);
+        }
+    }
+};
+
+#endif
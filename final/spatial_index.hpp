@@ -0,0 +1,175 @@
+#ifndef INCLUDE_SPATIAL_INDEX_HPP
+#define INCLUDE_SPATIAL_INDEX_HPP
+
+#include <vector>
+#include <cmath>
+#include "allocore/io/al_App.hpp"
+#include "../gravity/spatial_grid.hpp"
+#include "entity_store.hpp"
+
+using namespace al;
+using namespace std;
+
+//one kind of thing in the world, put in a grid once per tick
+//positions are copied at build time, so every query in a tick sees the same
+//world no matter who has already moved. cells are as wide as the widest
+//radius anyone asks this layer about; a wider question still gets the right
+//answer, it just walks the whole layer. so does any question about a layer
+//of fewer than SCAN_BELOW bodies, where hashing the 27 cells around a point
+//costs more than looking at everything (about 250 bodies on a desktop).
+struct IndexLayer{
+    enum { SCAN_BELOW = 256, CELL_COST = 4 };   //a cell walked costs about CELL_COST bodies scanned
+
+    SpatialGrid grid;
+    vector<Vec3f> position;     //by index into the kind's own vector
+    Vec3f lo, hi;               //bounding box of position
+    float reach;                //cell size
+    float widest;               //largest scaleFactor, for locations
+
+    IndexLayer(){
+        reach = 1;
+        widest = 1;
+    }
+
+    void build(const vector<Vec3f>& points){
+        position = points;
+        widest = 1;
+        locate();
+    }
+
+    //anything with .position and .scaleFactor, i.e. a Location
+    template <typename Body>
+    void build(const vector<Body>& bodies){
+        position.resize(bodies.size());
+        widest = 0;
+        for (unsigned i = 0; i < bodies.size(); ++i){
+            position[i] = bodies[i].position;
+            if (bodies[i].scaleFactor > widest) widest = bodies[i].scaleFactor;
+        }
+        locate();
+    }
+
+    void locate(){
+        lo = hi = Vec3f(0,0,0);
+        if (!position.empty()) lo = hi = position[0];
+        for (unsigned i = 1; i < position.size(); ++i){
+            const Vec3f& p = position[i];
+            for (int a = 0; a < 3; ++a){
+                if (p[a] < lo[a]) lo[a] = p[a];
+                if (p[a] > hi[a]) hi[a] = p[a];
+            }
+        }
+        if (position.size() >= SCAN_BELOW){
+            grid.build(position.size(), [&](unsigned i) -> const Vec3f& { return position[i]; }, reach);
+        }
+    }
+
+    //calls visit(j, p - position[j], distance) for everything closer than radius
+    template <typename Visit>
+    void within(const Vec3f& p, float radius, Visit visit) const {
+        if (radius > grid.cellSize || position.size() < SCAN_BELOW){
+            for (unsigned j = 0; j < position.size(); ++j){
+                Vec3f difference = p - position[j];
+                float d = difference.mag();
+                if (d < radius) visit(j, difference, d);
+            }
+            return;
+        }
+        grid.neighbours(p, [&](unsigned j){
+            Vec3f difference = p - position[j];
+            float d = difference.mag();
+            if (d < radius) visit(j, difference, d);
+        });
+    }
+
+    //closest j closer than range for which accept(j) holds, -1 for none
+    //walks the grid in growing shells of cells and stops once nothing
+    //further out can beat what it has. once the shells would cost more than
+    //scanning the layer (accept turning most of them down, say) it scans
+    //instead, so a query never costs much more than the scan. ties go to the lower
+    //index, as they did for the linear scans this replaces.
+    template <typename Accept>
+    int nearest(const Vec3f& p, float range, Accept accept, float& distance) const {
+        if (position.size() < SCAN_BELOW) return scan(p, range, accept, distance);
+        int best = -1;
+        float cellSize = grid.cellSize;
+        Vec3f span;
+        for (int a = 0; a < 3; ++a){
+            span[a] = max(fabsf(p[a] - lo[a]), fabsf(hi[a] - p[a]));
+        }
+        int shells = (int)ceilf(min(range, span.mag()) / cellSize) + 1;
+        int cx = grid.cell(p.x), cy = grid.cell(p.y), cz = grid.cell(p.z);
+        for (int k = 0; k <= shells; ++k){
+            double cells = (2.0 * k + 1) * (2.0 * k + 1) * (2.0 * k + 1);
+            if (k > 0 && cells > position.size() / 8.0) return scan(p, range, accept, distance);
+            for (int dz = -k; dz <= k; ++dz){
+                for (int dy = -k; dy <= k; ++dy){
+                    //inside the shell only the two end cells of a row are new
+                    bool face = (dz == -k || dz == k || dy == -k || dy == k);
+                    int step = (face || k == 0) ? 1 : 2 * k;
+                    for (int dx = -k; dx <= k; dx += step){
+                        unsigned b = grid.hash(cx + dx, cy + dy, cz + dz);
+                        for (unsigned s = grid.cellStart[b]; s < grid.cellStart[b + 1]; ++s){
+                            unsigned j = grid.sorted[s];
+                            float d = (p - position[j]).mag();
+                            if (d >= range) continue;
+                            if (best >= 0 && (d > distance || (d == distance && (int)j > best))) continue;
+                            if (!accept(j)) continue;
+                            best = j;
+                            distance = d;
+                        }
+                    }
+                }
+            }
+            //anything not visited yet is at least k cells away
+            if (best >= 0 && distance <= k * cellSize) break;
+        }
+        return best;
+    }
+
+    template <typename Accept>
+    int scan(const Vec3f& p, float range, Accept accept, float& distance) const {
+        int best = -1;
+        for (unsigned j = 0; j < position.size(); ++j){
+            float d = (p - position[j]).mag();
+            if (d < range && (best < 0 || d < distance) && accept(j)){
+                best = j;
+                distance = d;
+            }
+        }
+        return best;
+    }
+};
+
+//everything the agents ask "who is near me" or "which is closest" about
+//built once per tick before the agents run, and shared by all of them
+struct WorldIndex{
+    IndexLayer miners;
+    IndexLayer workers;
+    IndexLayer capitalists;
+    IndexLayer factories;
+    IndexLayer resourcePoints;
+    IndexLayer buildings;
+
+    WorldIndex(){
+        miners.reach = 10;          //Miner::neightSenseRange
+        workers.reach = 3;          //a worker's desiredseparation
+        capitalists.reach = 3;      //a capitalist's desiredseparation
+        factories.reach = 45;       //Worker::sensitivityFactory
+        resourcePoints.reach = 30;  //Miner::sensitivityNRP
+        buildings.reach = 3;        //a capitalist's desiredseparation around a building of scale 1
+    }
+
+    template <typename Factory, typename Point, typename Building>
+    void build(const EntityStore& m, const EntityStore& w, const EntityStore& c,
+               const vector<Factory>& fs, const vector<Point>& nrps, const vector<Building>& mbs){
+        miners.build(m.kinematics.position);
+        workers.build(w.kinematics.position);
+        capitalists.build(c.kinematics.position);
+        factories.build(fs);
+        resourcePoints.build(nrps);
+        buildings.build(mbs);
+    }
+};
+
+#endif
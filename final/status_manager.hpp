@@ -114,7 +114,7 @@ struct MarketManager{
         for (int i = 0; i < miners.ms.size(); i++){
             sum1 += miners.ms[i].collectRate;
             sum2 += miners.ms[i].maxLoad;
-            sum3 += miners.ms[i].maxspeed;
+            sum3 += miners.store.traits.maxspeed;
         }
         averageCollectRate = sum1 / miners.ms.size();
         averageMaxLoad = sum2 / miners.ms.size();
@@ -144,36 +144,39 @@ struct MarketManager{
         richMiners = 0;
         richWorkers = 0;
         jobHuntingWorkers = 0;
-        for (int i = 0; i < capitalists.cs.size(); i ++){
-            if (!capitalists.cs[i].bankrupted()){
+        const vector<float>& capitalistHoldings = capitalists.store.ledger.capitalHoldings;
+        for (int i = 0; i < capitalistHoldings.size(); i ++){
+            if (!capitalists.store.bankrupted(i)){
                 liveCapitalists += 1;
-                if (capitalists.cs[i].capitalHoldings < capitalistPovertyLine){
+                if (capitalistHoldings[i] < capitalistPovertyLine){
                     poorCapitalists += 1; 
-                } else if (capitalists.cs[i].capitalHoldings > capitalistWealthLine){
+                } else if (capitalistHoldings[i] > capitalistWealthLine){
                     richCapitalists += 1;
                 }
             }
         }
-        for (int i = 0; i < workers.workers.size(); i ++){
-            if (!workers.workers[i].bankrupted()){
+        const vector<float>& workerHoldings = workers.store.ledger.capitalHoldings;
+        for (int i = 0; i < workerHoldings.size(); i ++){
+            if (!workers.store.bankrupted(i)){
                 liveWorkers += 1;
                 if (workers.workers[i].jobHunting == true){
                     jobHuntingWorkers += 1;
                 }
-                if (workers.workers[i].capitalHoldings < workerPovertyLine){
+                if (workerHoldings[i] < workerPovertyLine){
                     poorWorkers += 1;
-                } else if (workers.workers[i].capitalHoldings > workerWealthLine){
+                } else if (workerHoldings[i] > workerWealthLine){
                     richWorkers += 1;
                 }
             }
         }
         WorkerCapitalistRatio = liveWorkers / liveCapitalists;
-        for (int i = 0; i < miners.ms.size(); i++){
-            if (!miners.ms[i].bankrupted()){
+        const vector<float>& minerHoldings = miners.store.ledger.capitalHoldings;
+        for (int i = 0; i < minerHoldings.size(); i++){
+            if (!miners.store.bankrupted(i)){
                 liveMiners += 1;
-                if (miners.ms[i].capitalHoldings < minerPovertyLine){
+                if (minerHoldings[i] < minerPovertyLine){
                     poorMiners += 1; 
-                } else if (miners.ms[i].capitalHoldings > minerWealthLine){
+                } else if (minerHoldings[i] > minerWealthLine){
                     richMiners += 1;
                 }
             }
@@ -199,28 +202,31 @@ struct MarketManager{
         float sum9 = 0;
         float sum10 = 0;
         float sum11 = 0;
+        const Ledger& capitalistLedger = capitalists.store.ledger;
         for (int i = 0; i < capitalists.cs.size(); i ++){
-            sum1 += capitalists.cs[i].capitalHoldings;
+            sum1 += capitalistLedger.capitalHoldings[i];
             sum6 += capitalists.cs[i].workersPayCheck;
             sum8 += capitalists.cs[i].resourceHoldings;
-            sum11 += capitalists.cs[i].poetryHoldings;
+            sum11 += capitalistLedger.poetryHoldings[i];
         }
         averageCapitalistWealth = sum1 / liveCapitalists;
         averageWorkersPayCheck = sum6 / liveCapitalists;
         averageCapitalistResource = sum8 / liveCapitalists;
         averageCapitalistPoetryLevel = sum11 / liveCapitalists;
 
-        for (int i = 0; i < workers.workers.size(); i ++){
-            sum2 += workers.workers[i].capitalHoldings;
-            sum10 += workers.workers[i].poetryHoldings;
+        const Ledger& workerLedger = workers.store.ledger;
+        for (int i = 0; i < workerLedger.capitalHoldings.size(); i ++){
+            sum2 += workerLedger.capitalHoldings[i];
+            sum10 += workerLedger.poetryHoldings[i];
 
         }
         averageWorkerWealth = sum2 / liveWorkers;
         averageWorkerPoetryLevel = sum10 / liveWorkers;
 
-        for (int i = 0; i < miners.ms.size(); i++){
-            sum3 += miners.ms[i].capitalHoldings;
-            sum9 += miners.ms[i].poetryHoldings;
+        const Ledger& minerLedger = miners.store.ledger;
+        for (int i = 0; i < minerLedger.capitalHoldings.size(); i++){
+            sum3 += minerLedger.capitalHoldings[i];
+            sum9 += minerLedger.poetryHoldings[i];
         }
         averageMinerWealth = sum3 / liveMiners;
         averageMinerPoetryLevel = sum9 / liveMiners;
@@ -0,0 +1,298 @@
+#ifndef INCLUDE_TASK_GRAPH_HPP
+#define INCLUDE_TASK_GRAPH_HPP
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include "../gravity/thread_pool.hpp"
+
+using namespace std;
+
+//the phases of a tick as a dependency graph, run over a thread pool
+//every phase names the data it reads and writes. a phase waits for each
+//earlier phase it conflicts with (one of the two writes something the other
+//touches), so whatever order the graph lets them run in, the result is the
+//same as running them one after another in the order they were added.
+//shared state that is not a manager, like the global random generator,
+//has to be declared too. phases that work row by row can be cut into
+//chunks of rows, each a task of its own.
+//
+//ready tasks go on the deque of the thread that made them ready; a thread
+//with nothing left steals from the front of the others. every phase is
+//timed, so the critical path (the longest chain of phases through the
+//graph, chunks counted at their longest) says how much of the tick could
+//overlap at all.
+struct TaskGraph{
+    struct Phase{
+        string name;
+        vector<unsigned> reads;
+        vector<unsigned> writes;
+        vector<unsigned> after;     //earlier phases this one waits for
+        vector<unsigned> next;      //later phases waiting for this one
+        function<void(unsigned, unsigned)> body;    //rows [begin, end)
+        function<unsigned()> rows;  //empty for a phase that is one task
+        unsigned grain;             //rows per chunk
+
+        //one run
+        unsigned numRows;
+        unsigned chunks;
+        atomic<unsigned> waiting;   //phases in after not finished yet
+        atomic<unsigned> left;      //chunks not finished yet
+        vector<double> chunkTime;   //ms
+
+        //the last run
+        double work;                //ms, all chunks
+        double span;                //ms, the longest chunk
+        double finish;              //ms, end of the longest chain ending here
+        int critical;               //previous phase on that chain, -1 at a start
+    };
+
+    struct Task{
+        unsigned phase;
+        unsigned chunk;
+    };
+
+    struct Queue{
+        mutex m;
+        deque<Task> tasks;
+    };
+
+    deque<Phase> phases;            //deque, phases hold atomics and never move
+    vector<string> resources;
+    unique_ptr<Queue[]> queues;
+    unsigned numQueues;
+    atomic<unsigned> remaining;     //tasks not finished in this run
+
+    TaskGraph(){
+        numQueues = 0;
+        remaining = 0;
+    }
+
+    unsigned resource(const string& name){
+        for (unsigned r = 0; r < resources.size(); ++r){
+            if (resources[r] == name) return r;
+        }
+        resources.push_back(name);
+        return resources.size() - 1;
+    }
+
+    //a phase that runs as one task
+    void add(const string& name, initializer_list<const char*> reads, initializer_list<const char*> writes,
+             function<void()> body){
+        add(name, reads, writes, function<unsigned()>(), 1, [body](unsigned, unsigned){ body(); });
+    }
+
+    //a phase over rows(), cut into chunks of grain rows
+    void add(const string& name, initializer_list<const char*> reads, initializer_list<const char*> writes,
+             function<unsigned()> rows, unsigned grain, function<void(unsigned, unsigned)> body){
+        phases.emplace_back();
+        unsigned id = phases.size() - 1;
+        Phase& p = phases.back();
+        p.name = name;
+        for (const char* r : reads) p.reads.push_back(resource(r));
+        for (const char* w : writes) p.writes.push_back(resource(w));
+        p.body = body;
+        p.rows = rows;
+        p.grain = grain < 1 ? 1 : grain;
+        p.numRows = 0;
+        p.chunks = 1;
+        p.work = p.span = p.finish = 0;
+        p.critical = -1;
+        for (unsigned e = 0; e < id; ++e){
+            if (conflict(phases[e], p)){
+                phases[e].next.push_back(id);
+                p.after.push_back(e);
+            }
+        }
+    }
+
+    static bool touches(const vector<unsigned>& a, const vector<unsigned>& b){
+        for (unsigned x : a){
+            for (unsigned y : b){
+                if (x == y) return true;
+            }
+        }
+        return false;
+    }
+    static bool conflict(const Phase& a, const Phase& b){
+        return touches(a.writes, b.writes) || touches(a.writes, b.reads) || touches(a.reads, b.writes);
+    }
+
+    //runs every phase once; with a pool of one thread, in the order added
+    void run(ThreadPool& pool){
+        unsigned total = 0;
+        for (Phase& p : phases){
+            p.numRows = p.rows ? p.rows() : 1;
+            p.chunks = p.rows ? (p.numRows + p.grain - 1) / p.grain : 1;
+            if (p.chunks == 0) p.chunks = 1;
+            p.chunkTime.assign(p.chunks, 0.0);
+            p.waiting = p.after.size();
+            p.left = p.chunks;
+            total += p.chunks;
+        }
+        if (pool.size() == 1){
+            for (unsigned i = 0; i < phases.size(); ++i){
+                for (unsigned c = 0; c < phases[i].chunks; ++c){
+                    execute(Task{i, c});
+                }
+            }
+        } else {
+            if (numQueues != pool.size()){
+                numQueues = pool.size();
+                queues.reset(new Queue[numQueues]);
+            }
+            remaining = total;
+            for (unsigned i = 0; i < phases.size(); ++i){
+                if (phases[i].after.empty()) release(i, 0);
+            }
+            pool.run([this](unsigned t){ serve(t); });
+        }
+        measure();
+    }
+
+    void serve(unsigned t){
+        while (remaining.load(memory_order_acquire) > 0){
+            Task task;
+            if (take(t, task)){
+                execute(task);
+                //whoever finishes a phase queues what it unblocked locally
+                finished(task, t);
+            } else {
+                this_thread::yield();
+            }
+        }
+    }
+
+    //own work from the back, others' from the front
+    bool take(unsigned t, Task& task){
+        {
+            Queue& q = queues[t];
+            lock_guard<mutex> lock(q.m);
+            if (!q.tasks.empty()){
+                task = q.tasks.back();
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+        for (unsigned k = 1; k < numQueues; ++k){
+            Queue& q = queues[(t + k) % numQueues];
+            lock_guard<mutex> lock(q.m);
+            if (!q.tasks.empty()){
+                task = q.tasks.front();
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void release(unsigned phase, unsigned t){
+        Queue& q = queues[t];
+        lock_guard<mutex> lock(q.m);
+        //chunk 0 ends up on top for the owner, thieves take from the far end
+        for (unsigned c = phases[phase].chunks; c-- > 0; ){
+            q.tasks.push_back(Task{phase, c});
+        }
+    }
+
+    void execute(const Task& task){
+        Phase& p = phases[task.phase];
+        unsigned begin = task.chunk * p.grain;
+        unsigned end = p.rows ? min(p.numRows, begin + p.grain) : 1;
+        if (!p.rows) begin = 0;
+        auto t0 = chrono::steady_clock::now();
+        p.body(begin, end);
+        p.chunkTime[task.chunk] = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    }
+
+    void finished(const Task& task, unsigned t){
+        Phase& p = phases[task.phase];
+        if (p.left.fetch_sub(1, memory_order_acq_rel) == 1){
+            for (unsigned n : p.next){
+                if (phases[n].waiting.fetch_sub(1, memory_order_acq_rel) == 1){
+                    release(n, t);
+                }
+            }
+        }
+        remaining.fetch_sub(1, memory_order_acq_rel);
+    }
+
+    //phases were added in an order the graph allows, so one pass finds
+    //the longest chain ending at each of them
+    void measure(){
+        for (Phase& p : phases){
+            p.work = 0;
+            p.span = 0;
+            for (double ms : p.chunkTime){
+                p.work += ms;
+                if (ms > p.span) p.span = ms;
+            }
+            double start = 0;
+            p.critical = -1;
+            for (unsigned e : p.after){
+                if (phases[e].finish > start){
+                    start = phases[e].finish;
+                    p.critical = e;
+                }
+            }
+            p.finish = start + p.span;
+        }
+    }
+
+    //ms of the last run, summed over every task
+    double work() const {
+        double sum = 0;
+        for (const Phase& p : phases) sum += p.work;
+        return sum;
+    }
+
+    //ms of the last run along the longest chain, what no thread count can beat
+    double criticalPath() const {
+        double longest = 0;
+        for (const Phase& p : phases){
+            if (p.finish > longest) longest = p.finish;
+        }
+        return longest;
+    }
+
+    //the phases on the critical path, first to last
+    vector<unsigned> criticalPhases() const {
+        int last = -1;
+        double longest = -1;
+        for (unsigned i = 0; i < phases.size(); ++i){
+            if (phases[i].finish > longest){
+                longest = phases[i].finish;
+                last = i;
+            }
+        }
+        vector<unsigned> chain;
+        for (int i = last; i >= 0; i = phases[i].critical){
+            chain.insert(chain.begin(), i);
+        }
+        return chain;
+    }
+
+    void report(ostream& out) const {
+        double w = work();
+        double cp = criticalPath();
+        out << "tick: " << w << " ms of work, critical path " << cp << " ms";
+        if (cp > 0) out << ", parallelism " << w / cp;
+        out << endl << "  ";
+        vector<unsigned> chain = criticalPhases();
+        for (unsigned k = 0; k < chain.size(); ++k){
+            const Phase& p = phases[chain[k]];
+            out << (k ? " > " : "") << p.name << " " << p.span;
+        }
+        out << endl;
+    }
+};
+
+#endif
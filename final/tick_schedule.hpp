@@ -0,0 +1,160 @@
+#ifndef INCLUDE_TICK_SCHEDULE_HPP
+#define INCLUDE_TICK_SCHEDULE_HPP
+
+#include <thread>
+#include "helper.hpp"
+#include "agent_managers.hpp"
+#include "location_managers.hpp"
+#include "spatial_index.hpp"
+#include "task_graph.hpp"
+
+using namespace std;
+
+//one tick of the economy as a TaskGraph
+//the phases are added in the order the tick used to call them one by one,
+//with what each of them reads and writes, so the graph reproduces that
+//order exactly while letting unrelated phases overlap. "rng" is the global
+//random generator (rand() and rnd::), which the location and agent phases
+//draw from; declaring it keeps the draws in the same order too.
+//press 'p' in the simulator for the critical path of the last tick.
+struct TickSchedule{
+    TaskGraph graph;
+    ThreadPool pool;
+
+    MarketManager* market;
+    Metropolis* metropolis;
+    Factories* factories;
+    NaturalResourcePointsCollection* resourcePoints;
+    Capitalist_Entity* capitalists;
+    Miner_Group* miners;
+    Worker_Union* workers;
+    WorldIndex* world;
+
+    TickSchedule(){
+        pool.resize(thread::hardware_concurrency());
+    }
+
+    void threads(unsigned n){
+        pool.resize(n);
+    }
+
+    void declare(MarketManager& m, Metropolis& mp, Factories& fs, NaturalResourcePointsCollection& nrps,
+                 Capitalist_Entity& cs, Miner_Group& ms, Worker_Union& ws, WorldIndex& wi){
+        market = &m;
+        metropolis = &mp;
+        factories = &fs;
+        resourcePoints = &nrps;
+        capitalists = &cs;
+        miners = &ms;
+        workers = &ws;
+        world = &wi;
+        TaskGraph& g = graph;
+        unsigned grain = 1024;     //rows per chunk of the column passes
+
+        //market
+        g.add("market.population", {"capitalists", "workers", "miners", "factories"}, {"market"}, [this](){
+            market->populationMonitor(*capitalists, *workers, *miners, factories->fs);
+        });
+        g.add("market.capital", {"capitalists", "workers", "miners", "factories"}, {"market"}, [this](){
+            market->capitalMonitor(*capitalists, *workers, *miners, factories->fs);
+        });
+        g.add("market.price", {"capitalists", "workers", "miners"}, {"market"}, [this](){
+            market->updatePrice(*capitalists, *workers, *miners);
+        });
+
+        //related to market
+        g.add("factories.laborPrice", {"market"}, {"factories"}, [this](){
+            factories->getLaborPrice(*market);
+        });
+        g.add("miners.resourcePrice", {"factories"}, {"miners"}, [this](){
+            miners->calculateResourceUnitPrice(factories->fs);
+        });
+
+        //locations
+        g.add("metropolis.run", {}, {"metropolis"}, [this](){
+            metropolis->run();
+        });
+        g.add("factories.run", {"capitalists"}, {"factories"}, [this](){
+            factories->run(*capitalists);
+        });
+        g.add("resourcePoints.run", {}, {"resourcePoints", "rng"}, [this](){
+            resourcePoints->run();
+        });
+
+        //who is where as the agents start moving
+        g.add("index.miners", {"miners"}, {"index.miners"}, [this](){
+            world->miners.build(miners->store.kinematics.position);
+        });
+        g.add("index.workers", {"workers"}, {"index.workers"}, [this](){
+            world->workers.build(workers->store.kinematics.position);
+        });
+        g.add("index.capitalists", {"capitalists"}, {"index.capitalists"}, [this](){
+            world->capitalists.build(capitalists->store.kinematics.position);
+        });
+        g.add("index.factories", {"factories"}, {"index.factories"}, [this](){
+            world->factories.build(factories->fs);
+        });
+        g.add("index.resourcePoints", {"resourcePoints"}, {"index.resourcePoints"}, [this](){
+            world->resourcePoints.build(resourcePoints->nrps);
+        });
+        g.add("index.buildings", {"metropolis"}, {"index.buildings"}, [this](){
+            world->buildings.build(metropolis->mbs);
+        });
+
+        //agents
+        g.add("capitalists.decide", {"index.buildings", "metropolis"}, {"capitalists", "rng"}, [this](){
+            capitalists->decide(*world, metropolis->mbs);
+        });
+        g.add("capitalists.move", {}, {"capitalists"}, [this](){ return capitalists->store.size(); }, grain,
+            [this](unsigned begin, unsigned end){ capitalists->move(begin, end); });
+        g.add("miners.decide", {"index.miners", "index.resourcePoints", "capitalists"}, {"miners", "resourcePoints", "rng"}, [this](){
+            miners->decide(*world, resourcePoints->nrps, capitalists->cs);
+        });
+        g.add("miners.move", {}, {"miners"}, [this](){ return miners->store.size(); }, grain,
+            [this](unsigned begin, unsigned end){ miners->move(begin, end); });
+        g.add("miners.visualize", {"resourcePoints"}, {"miners"}, [this](){
+            miners->visualize(resourcePoints->nrps);
+        });
+        g.add("workers.decide", {"index.workers", "factories", "capitalists"}, {"workers", "rng"}, [this](){
+            workers->decide(*world, factories->fs, capitalists->cs);
+        });
+        g.add("workers.move", {}, {"workers"}, [this](){ return workers->store.size(); }, grain,
+            [this](unsigned begin, unsigned end){ workers->move(begin, end); });
+        g.add("workers.visualize", {"factories"}, {"workers"}, [this](){
+            workers->visualize(factories->fs);
+        });
+
+        //interaction between groups
+        g.add("resourcePoints.checkMinerPick", {"miners"}, {"resourcePoints"}, [this](){
+            resourcePoints->checkMinerPick(miners->ms);
+        });
+        g.add("factories.checkWorkerNum", {"workers"}, {"factories"}, [this](){
+            factories->checkWorkerNum(workers->workers);
+        });
+        g.add("metropolis.mapCapitalistStats", {"capitalists"}, {"metropolis"}, [this](){
+            metropolis->mapCapitalistStats(*capitalists);
+        });
+        g.add("capitalists.getResource", {"miners"}, {"capitalists"}, [this](){
+            capitalists->getResource(miners->ms);
+        });
+        g.add("capitalists.getWorkersPaymentStats", {"factories"}, {"capitalists"}, [this](){
+            capitalists->getWorkersPaymentStats(factories->fs);
+        });
+
+        //pay workers
+        g.add("factories.payWorkers", {"market"}, {"factories"}, [this](){
+            factories->payWorkers(*market);
+        });
+
+        //locational behaviors
+        g.add("factories.drawLinks", {"capitalists"}, {"factories"}, [this](){
+            factories->drawLinks(*capitalists);
+        });
+    }
+
+    void run(){
+        graph.run(pool);
+    }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "voices.hpp"
+#include "voice_pool.hpp"
+using namespace al;
+using namespace std;
+
+//how many agent voices fit in an audio block, per core
+//no window, no simulation, no spatializer: renders --voices voices of a
+//kind into their own blocks over a VoicePool of each thread count, the way
+//onSound does, and compares the time per block with the block's real time
+//budget (--frames / --rate). voices/core is the number of voices that
+//would fill the budget divided by the threads rendering them.
+//
+//build it like the other final apps, e.g.
+//  c++ -O3 -march=native -std=c++11 -pthread voice_benchmark.cpp -lallocore -lGamma -o voice_benchmark
+//
+//usage: voice_benchmark [--voices 64,256] [--threads 1,2,4,8] [--kinds capitalist,worker]
+//                       [--blocks 400] [--frames 256] [--rate 44100] [--csv]
+//
+//--threads defaults to 1, 2, 4 .. up to the number of cores.
+
+struct VoiceBenchConfig{
+    vector<unsigned> voices;
+    vector<unsigned> threads;
+    vector<string> kinds;
+    unsigned blocks;
+    unsigned frames;
+    double rate;
+    bool csv;
+
+    VoiceBenchConfig(){
+        unsigned defaultVoices[] = { 64, 256 };
+        voices.assign(defaultVoices, defaultVoices + 2);
+        unsigned cores = thread::hardware_concurrency();
+        for (unsigned t = 1; t < cores; t *= 2) threads.push_back(t);
+        threads.push_back(cores > 0 ? cores : 1);
+        kinds.push_back("capitalist");
+        kinds.push_back("worker");
+        blocks = 400;
+        frames = 256;
+        rate = 44100;
+        csv = false;
+    }
+};
+
+vector<string> split(const string& s){
+    vector<string> parts;
+    size_t start = 0;
+    while (start <= s.size()){
+        size_t comma = s.find(',', start);
+        if (comma == string::npos) comma = s.size();
+        if (comma > start) parts.push_back(s.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return parts;
+}
+
+//ms per block of count voices of one kind on a pool
+template <typename Voice>
+double timeBlocks(vector<Voice>& voices, VoiceBlocks& blocks, VoicePool& pool, const VoiceBenchConfig& config){
+    unsigned frames = config.frames;
+    auto renderVoice = [&](unsigned v){ voices[v].render(blocks[v], frames); };
+    //warm the caches and wake the helpers
+    for (unsigned b = 0; b < 10; ++b) pool.run(renderVoice, voices.size());
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    for (unsigned b = 0; b < config.blocks; ++b){
+        pool.run(renderVoice, voices.size());
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / config.blocks;
+}
+
+int main(int argc, char* argv[]){
+    VoiceBenchConfig config;
+    for (int i = 1; i < argc; ++i){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--voices" && hasValue){
+            config.voices.clear();
+            for (string v : split(argv[++i])) config.voices.push_back(atoi(v.c_str()));
+        } else if (arg == "--threads" && hasValue){
+            config.threads.clear();
+            for (string t : split(argv[++i])) config.threads.push_back(atoi(t.c_str()));
+        } else if (arg == "--kinds" && hasValue){
+            config.kinds = split(argv[++i]);
+        } else if (arg == "--blocks" && hasValue){
+            config.blocks = atoi(argv[++i]);
+        } else if (arg == "--frames" && hasValue){
+            config.frames = atoi(argv[++i]);
+        } else if (arg == "--rate" && hasValue){
+            config.rate = atof(argv[++i]);
+        } else if (arg == "--csv"){
+            config.csv = true;
+        } else {
+            fprintf(stderr, "unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+    for (const string& kind : config.kinds){
+        if (kind != "capitalist" && kind != "worker"){
+            fprintf(stderr, "unknown voice kind %s\n", kind.c_str());
+            return 1;
+        }
+    }
+
+    //the voices' oscillators take the rate when they are made
+    gam::Sync::master().spu(config.rate);
+    double budget = 1000.0 * config.frames / config.rate;
+
+    if (config.csv){
+        printf("kind,voices,threads,ms_per_block,budget_percent,voices_in_budget,voices_per_core,speedup\n");
+    } else {
+        printf("%u blocks of %u frames at %g Hz, %.3f ms per block\n", config.blocks, config.frames, config.rate, budget);
+        printf("%11s %7s %7s %12s %8s %10s %11s %8s\n", "kind", "voices", "threads", "ms/block", "budget",
+               "in budget", "voices/core", "speedup");
+    }
+    VoicePool pool;
+    for (const string& kind : config.kinds){
+        for (unsigned count : config.voices){
+            double first = 0;
+            for (unsigned threads : config.threads){
+                pool.resize(threads);
+                VoiceBlocks blocks;
+                blocks.resize(count, config.frames);
+                double ms;
+                if (kind == "capitalist"){
+                    vector<CapitalistVoice> voices(count);
+                    ms = timeBlocks(voices, blocks, pool, config);
+                } else {
+                    vector<WorkerVoice> voices(count);
+                    for (WorkerVoice& v : voices) v.noiseLevel = 0.2;
+                    ms = timeBlocks(voices, blocks, pool, config);
+                }
+                if (first == 0) first = ms;
+                double fit = ms > 0 ? count * budget / ms : 0;
+                if (config.csv){
+                    printf("%s,%u,%u,%.4f,%.1f,%.0f,%.0f,%.3f\n", kind.c_str(), count, pool.size(), ms,
+                           100 * ms / budget, fit, fit / pool.size(), first / ms);
+                } else {
+                    printf("%11s %7u %7u %12.4f %7.1f%% %10.0f %11.0f %8.2f\n", kind.c_str(), count, pool.size(), ms,
+                           100 * ms / budget, fit, fit / pool.size(), first / ms);
+                }
+                fflush(stdout);
+            }
+        }
+    }
+    return 0;
+}
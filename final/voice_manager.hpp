@@ -0,0 +1,134 @@
+#ifndef INCLUDE_VOICE_MANAGER_HPP
+#define INCLUDE_VOICE_MANAGER_HPP
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+//which agents are heard
+//the audio renders a fixed number of voices, however many agents there
+//are. once per block every candidate gets a score for how loud it would
+//arrive (its attenuation at its distance times the loudness of its voice)
+//and the loudest ones hold the voices. the rest are virtual: nothing is
+//rendered for them and their voices keep their state until they come back.
+//a voice taken over by another agent fades the old one out while the new
+//one fades in, over one block.
+struct VoiceManager{
+    enum { NONE = -1 };
+
+    struct Slot{
+        int candidate;          //who is playing, NONE for nobody
+        int fading;             //who is fading out this block, NONE for nobody
+        bool fresh;             //candidate fades in this block
+    };
+
+    vector<Slot> slots;
+    vector<int> slotOf;         //per candidate, NONE when virtual
+    vector<float> score;        //per candidate, filled by the caller
+    vector<unsigned> ranked;
+    vector<char> chosen;
+    unsigned numCandidates;
+    float hold;                 //a playing candidate's score counts this much more,
+                                //so two close ones don't trade the voice every block
+
+    VoiceManager(){
+        numCandidates = 0;
+        hold = 1.25;
+    }
+
+    //everything the audio thread will touch, before it starts
+    void reserve(unsigned voices, unsigned maxCandidates){
+        slots.resize(voices);
+        for (Slot& s : slots){
+            s.candidate = NONE;
+            s.fading = NONE;
+            s.fresh = false;
+        }
+        slotOf.assign(maxCandidates, NONE);
+        score.assign(maxCandidates, 0.0f);
+        ranked.resize(maxCandidates);
+        chosen.assign(maxCandidates, 0);
+    }
+
+    //candidates beyond what was reserved are never heard. the ones that
+    //are gone lose their voice at once, there is nothing left to fade
+    void candidates(unsigned n){
+        numCandidates = min<unsigned>(n, score.size());
+        for (Slot& s : slots){
+            if (s.candidate >= (int)numCandidates){
+                slotOf[s.candidate] = NONE;
+                s.candidate = NONE;
+                s.fresh = false;
+            }
+            if (s.fading >= (int)numCandidates) s.fading = NONE;
+        }
+    }
+
+    //hands the voices to the loudest candidates after score[] is filled
+    void choose(){
+        unsigned n = 0;
+        for (unsigned c = 0; c < numCandidates; ++c){
+            chosen[c] = 0;
+            if (score[c] <= 0) continue;
+            if (slotOf[c] != NONE) score[c] *= hold;
+            ranked[n++] = c;
+        }
+        unsigned k = min<unsigned>(n, slots.size());
+        const vector<float>& s = score;
+        nth_element(ranked.begin(), ranked.begin() + k, ranked.begin() + n, [&s](unsigned a, unsigned b){
+            return s[a] > s[b];
+        });
+        for (unsigned r = 0; r < k; ++r) chosen[ranked[r]] = 1;
+
+        //let go of the ones that dropped out, then seat the new ones
+        for (unsigned v = 0; v < slots.size(); ++v){
+            int c = slots[v].candidate;
+            if (c != NONE && !chosen[c]) release(v);
+        }
+        unsigned v = 0;
+        for (unsigned r = 0; r < k; ++r){
+            unsigned c = ranked[r];
+            if (slotOf[c] != NONE) continue;
+            while (slots[v].candidate != NONE) v++;
+            slots[v].candidate = c;
+            slots[v].fresh = true;
+            slotOf[c] = v;
+        }
+    }
+
+    void release(unsigned v){
+        Slot& s = slots[v];
+        slotOf[s.candidate] = NONE;
+        s.fading = s.fresh ? NONE : s.candidate;    //never heard, nothing to fade
+        s.candidate = NONE;
+        s.fresh = false;
+    }
+
+    //after the block is rendered
+    void settle(){
+        for (Slot& s : slots){
+            s.fading = NONE;
+            s.fresh = false;
+        }
+    }
+
+    //the candidates being heard
+    unsigned playing() const {
+        unsigned n = 0;
+        for (const Slot& s : slots){
+            if (s.candidate != NONE) n++;
+        }
+        return n;
+    }
+};
+
+//scales a block by a ramp from `from` to `to`
+inline void ramp(float* out, unsigned frames, float from, float to){
+    float step = frames > 0 ? (to - from) / frames : 0;
+    for (unsigned k = 0; k < frames; ++k){
+        out[k] *= from + (k + 1) * step;
+    }
+}
+
+#endif
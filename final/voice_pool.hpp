@@ -0,0 +1,162 @@
+#ifndef INCLUDE_VOICE_POOL_HPP
+#define INCLUDE_VOICE_POOL_HPP
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//items of a job spread over helper threads, safe to call from the audio callback
+//the helpers are spawned once and never block on anything the callback
+//holds: they poll one atomic word, the ticket, which packs the job's
+//generation, its number of items and the next item to take. run() writes
+//the job, publishes a new ticket and takes items itself like any helper;
+//an item is claimed by a compare-exchange that only succeeds while the
+//ticket still belongs to its job. the callback waits for nothing but the
+//items other threads are already in the middle of, so a helper that is
+//asleep when a job starts costs parallelism, not the deadline. no locks,
+//no std::function and no allocation once the helpers are running.
+//
+//idle helpers spin a little, then yield, then nap for NAP_US between
+//polls, so a pool with nothing to do costs next to no cpu; the first block
+//after a pause may run mostly on the callback thread. size it to the cores
+//the rest of the app leaves free: a helper preempted halfway through an
+//item keeps the callback waiting for that item.
+struct VoicePool{
+    typedef void (*Job)(void* context, unsigned item);
+
+    enum { SPINS = 4096, YIELDS = 64, NAP_US = 100, MAX_ITEMS = 0xffff };
+
+    //generation << 32 | items << 16 | next
+    atomic<uint64_t> ticket;
+    atomic<unsigned> done;          //items of the current job finished
+    Job job;
+    void* context;
+    atomic<bool> quit;
+    vector<thread> helpers;
+
+    VoicePool(){
+        ticket = 0;
+        done = 0;
+        job = 0;
+        context = 0;
+        quit = false;
+    }
+    ~VoicePool(){
+        stop();
+    }
+
+    //threads that render, the caller of run() included
+    unsigned size() const {
+        return helpers.size() + 1;
+    }
+
+    //not from the audio thread
+    void resize(unsigned n){
+        if (n < 1) n = 1;
+        if (n == size()) return;
+        stop();
+        quit = false;
+        for (unsigned t = 1; t < n; ++t){
+            helpers.push_back(thread([this](){ help(); }));
+        }
+    }
+
+    void stop(){
+        quit.store(true, memory_order_release);
+        for (thread& h : helpers) h.join();
+        helpers.clear();
+    }
+
+    //calls f(item) for every item in [0, items) and returns when all are done
+    template <typename F>
+    void run(F& f, unsigned items){
+        run([](void* c, unsigned item){ (*static_cast<F*>(c))(item); }, &f, items);
+    }
+
+    void run(Job j, void* c, unsigned items){
+        if (items == 0) return;
+        if (items > MAX_ITEMS) items = MAX_ITEMS;
+        if (helpers.empty()){
+            for (unsigned i = 0; i < items; ++i) j(c, i);
+            return;
+        }
+        //the last job is finished, nobody reads these until the new ticket
+        job = j;
+        context = c;
+        done.store(0, memory_order_relaxed);
+        uint64_t generation = (ticket.load(memory_order_relaxed) >> 32) + 1;
+        ticket.store(generation << 32 | (uint64_t)items << 16, memory_order_release);
+
+        unsigned item;
+        while (claim(generation, item)){
+            j(c, item);
+            done.fetch_add(1, memory_order_acq_rel);
+        }
+        //items in flight on other threads; if one of them was preempted
+        //(more threads than free cores) give it the core back
+        for (unsigned spins = 0; done.load(memory_order_acquire) < items; ++spins){
+            if (spins < SPINS) relax();
+            else this_thread::yield();
+        }
+    }
+
+    //false once the job of this generation has no items left to take
+    bool claim(uint64_t generation, unsigned& item){
+        uint64_t t = ticket.load(memory_order_acquire);
+        while (true){
+            unsigned items = (t >> 16) & 0xffff;
+            unsigned next = t & 0xffff;
+            if ((t >> 32) != generation || next >= items) return false;
+            if (ticket.compare_exchange_weak(t, t + 1, memory_order_acq_rel, memory_order_acquire)){
+                item = next;
+                return true;
+            }
+        }
+    }
+
+    static void relax(){
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        this_thread::yield();
+#endif
+    }
+
+    void help(){
+        uint64_t seen = ticket.load(memory_order_acquire) >> 32;
+        unsigned idle = 0;
+        while (!quit.load(memory_order_acquire)){
+            uint64_t generation = ticket.load(memory_order_acquire) >> 32;
+            if (generation != seen){
+                seen = generation;
+                idle = 0;
+                unsigned item;
+                while (claim(generation, item)){
+                    //an item taken is an item of this job, whose fields stay
+                    //put until it is done
+                    job(context, item);
+                    done.fetch_add(1, memory_order_acq_rel);
+                }
+                continue;
+            }
+            idle++;
+            if (idle < SPINS){
+                relax();
+            } else if (idle < SPINS + YIELDS){
+                this_thread::yield();
+            } else {
+                this_thread::sleep_for(chrono::microseconds(NAP_US));
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef INCLUDE_VOICES_HPP
+#define INCLUDE_VOICES_HPP
+
+#include <vector>
+#include <algorithm>
+#include "allocore/io/al_App.hpp"
+#include "Gamma/Filter.h"
+#include "Gamma/Envelope.h"
+#include "Gamma/DFT.h"
+#include "Gamma/Effects.h"
+#include "Gamma/Delay.h"
+#include "Gamma/Noise.h"
+#include "Gamma/Oscillator.h"
+#include "Gamma/SamplePlayer.h"
+
+using namespace al;
+using namespace std;
+
+//the sounds of the agents, apart from the agents themselves
+//an agent only carries a voice id in its EntityStore row, so agents that
+//are not heard carry no oscillators, filters or delay lines at all.
+//a voice renders a whole audio block at a time into a buffer of its own.
+
+// SampleLooper from Karl
+//
+typedef gam::SamplePlayer<float, gam::ipl::Cubic, gam::tap::Wrap>
+    GammaSamplePlayerFloatCubicWrap;
+
+struct DynamicSamplePlayer : GammaSamplePlayerFloatCubicWrap {
+  DynamicSamplePlayer() : GammaSamplePlayerFloatCubicWrap() { zero(); }
+  DynamicSamplePlayer(const DynamicSamplePlayer& other) {}
+
+  // need this for some old version of gcc
+  DynamicSamplePlayer& operator=(const DynamicSamplePlayer& other) {
+    return *this;
+  }
+};
+
+class Vibrato{
+public:
+	Vibrato(float modAmount=1./400, float modFreq=5)
+	:	modAmount(modAmount),
+		delay(0.1, 0), mod(modFreq)
+	{}
+
+	float operator()(float i){
+		delay.delay(mod.hann()*modAmount + 0.0001);
+		return delay(i);
+	}
+
+	float modAmount;
+	gam::Delay<> delay;
+	gam::LFO<> mod;
+};
+
+struct CapitalistVoice{
+    enum { CHUNK = 256 };   //samples per stage of render()
+
+    //gamma effects
+    //gam::LFO<> osc;
+    gam::SineD<> sine;
+	gam::LFO<> shiftMod;
+    gam::LFO<> mod;
+	gam::Hilbert<> hil;
+	gam::CSine<> shifter;
+    // gam::Biquad<> bq;
+    gam::OnePole<> onePole;
+    gam::Accum<> tmr;
+    gam::NoisePink<> s_noise;
+    gam::Delay<float, gam::ipl::Trunc> delay;
+    Vibrato vibrato;
+    unsigned seed;          //the voice's own random numbers, gam::rnd is one
+                            //generator for everybody and voices render on any thread
+
+    CapitalistVoice(){
+        static unsigned voices = 0;
+        seed = 2891336453u * ++voices;
+
+        //effects
+        //sine
+        sine.freq(440);
+
+        //for hilbert
+		shiftMod.period(16);
+        shifter.freq(200);
+
+        //for one pole
+        mod.period(120);
+        mod.phase(0.5);
+
+        //biquad
+        // bq.res(4);
+        // bq.level(2);
+
+        //delay
+        tmr.period(0.75);
+        tmr.phaseMax();
+        delay.maxDelay(0.4);
+        delay.delay(0.2);
+    }
+
+    //[lo, hi), like gam::rnd::uni
+    float uni(float hi, float lo){
+        seed = seed * 1664525u + 1013904223u;
+        return lo + (hi - lo) * ((seed >> 8) * (1.0f / 16777216));
+    }
+    //[lo, hi) leaning toward lo, like gam::rnd::lin
+    float lin(float hi, float lo){
+        return lo + (hi - lo) * min(uni(1, 0), uni(1, 0));
+    }
+
+    //roughly the peak of the mix, to rank voices by
+    float loudness() const {
+        return 0.1;
+    }
+
+    //a block, stage by stage over chunks of up to CHUNK samples: each loop
+    //keeps one unit's state in registers, the plain arithmetic ones vectorize
+    void render(float* out, unsigned frames){
+        float source[CHUNK];
+        float sineClick[CHUNK];
+        float s[CHUNK];
+        for (unsigned start = 0; start < frames; start += CHUNK){
+            unsigned n = min<unsigned>(CHUNK, frames - start);
+            for (unsigned k = 0; k < n; ++k){
+                if (tmr()){
+                    sine.set(uni(10,1)*50, 0.2, lin(2., 0.1));
+                }
+                source[k] = sine();
+                sineClick[k] = sine();
+            }
+
+            //hilbert transformation
+            for (unsigned k = 0; k < n; ++k){
+                gam::Complex<float> c = hil(source[k]);
+                shifter.freq(shiftMod.hann()*200);
+                c *= shifter();
+                s[k] = c.r + c.i;
+            }
+
+            //one pole
+            for (unsigned k = 0; k < n; ++k){
+                float cutoff = gam::scl::pow3(mod.triU()) * 2000;
+                onePole.freq(1000 + cutoff * 0.2);
+                s[k] = onePole(s[k]) * 0.2;
+            }
+            //float s = onePole(sr) * 0.3 + onePole(si) * 0.3;
+            //float s = onePole(sr + si) * 0.2 + s_noise() * gam::scl::pow3(mod.triU()) * 0.06;
+
+            for (unsigned k = 0; k < n; ++k){
+                s[k] = vibrato(s[k]);
+            }
+
+            //biquad
+            // bq.type(gam::BAND_PASS);
+            // bq.freq(500 + cutoff * 0.08);
+            float* o = out + start;
+            for (unsigned k = 0; k < n; ++k){
+                o[k] = s[k] * 0.7f + sineClick[k] * 0.3f;
+            }
+            //delay
+            // if (tmr()) {
+            //     sample = bq(s);
+            // }
+            // sample += delay(sample + delay()*0.2);
+            //sample += delay(sample) + delay.read(0.15) + delay.read(0.39);
+        }
+    }
+};
+
+struct WorkerVoice{
+    gam::Sine<> src;
+    gam::AD<> env;
+    gam::LFO<> mod;
+    gam::NoisePink<> pink;
+    gam::Accum<> tmr;
+    float sample;
+    float noiseLevel;   //set from the worker's crowd every tick
+    Vibrato vibrato;
+
+    WorkerVoice(){
+        //noted pink noise
+        tmr.period(4.5);
+        env.attack(0.01).decay(0.24);
+        noiseLevel = 0.0;
+        sample = 0;
+    }
+
+    float loudness() const {
+        return 0.1 * noiseLevel;
+    }
+
+    void render(float* out, unsigned frames){
+        // if (tmr()){
+        //     float frq = rnd::uniformS() * 880 + 30;
+        //     src.freq(frq);
+        //     env.reset();
+        // }
+
+        //float s = src() * env() * 0.05 +
+        //float s = src() * env() * 0.1 * noiseLevel;
+        for (unsigned k = 0; k < frames; ++k){
+            out[k] = pink();
+        }
+        float gain = 0.1 * noiseLevel;
+        for (unsigned k = 0; k < frames; ++k){
+            out[k] *= gain;
+        }
+
+        //s = vibrato(s);
+        if (frames > 0) sample = out[frames - 1];
+    }
+};
+
+//one block of samples per voice, side by side in a single allocation
+//sized once before the audio starts, so the callback never allocates
+struct VoiceBlocks{
+    vector<float> samples;
+    unsigned frames;
+
+    VoiceBlocks(){
+        frames = 0;
+    }
+
+    void resize(unsigned voices, unsigned framesPerBlock){
+        frames = framesPerBlock;
+        samples.assign(voices * frames, 0.0f);
+    }
+
+    unsigned size() const {
+        return frames > 0 ? samples.size() / frames : 0;
+    }
+
+    float* operator[](unsigned voice){
+        return &samples[voice * frames];
+    }
+};
+
+#endif
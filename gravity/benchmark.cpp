@@ -0,0 +1,358 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <new>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "particle_system.hpp"
+using namespace al;
+using namespace std;
+
+//headless benchmark for the gravity simulation
+//no window, no audio, no cuttlebone: builds a ParticleSystem, seeds it
+//deterministically, runs fixed steps with every force solver and prints
+//steps/s, ns per pair, memory per run, energy / momentum drift, and for the
+//approximate solvers the rms force error against the exact sum.
+//on linux it also counts last level cache misses per step (perf events,
+//nan when the kernel does not allow it).
+//
+//build it like the other gravity apps, e.g.
+//  c++ -O3 -march=native -std=c++11 -pthread benchmark.cpp -lallocore -o benchmark
+//
+//usage: benchmark [--steps 20] [--counts 50,500,5000] [--modes pairwise,barnes-hut,simd,parallel,pm]
+//                 [--threads 8] [--theta 0.5] [--grids 16,32,64] [--sorts 0,32] [--seed 1]
+//                 [--conservative] [--all] [--csv]
+//
+//--conservative turns off the acceleration clamp, springs, boundary and
+//life decay (and uses gravity 10), so the drift columns measure the solver
+//and integrator alone instead of the app's deliberately lossy physics.
+//exact O(N^2) modes are skipped past 2e10 pair evaluations unless --all.
+//pm runs once per --grids size, so one call covers grid size against
+//speed and accuracy. every run repeats for each --sorts interval (steps
+//between morton re-sorts, 0 never), so one call shows what the sort buys.
+//bodies are seeded in random memory order, the worst case for the cache.
+//run MB is the most heap the run held on top of what was there before it
+//(particles, tree, grid, mesh, scratch), so every row shows its own size.
+
+struct BenchConfig{
+    unsigned steps;
+    vector<unsigned> counts;
+    vector<int> modes;
+    vector<unsigned> grids;
+    vector<unsigned> sorts;
+    unsigned threads;
+    unsigned seed;
+    bool conservative;
+    bool all;
+    bool csv;
+
+    BenchConfig(){
+        steps = 20;
+        unsigned defaultCounts[] = { 50, 100, 500, 1000, 5000, 10000, 50000, 100000 };
+        counts.assign(defaultCounts, defaultCounts + 8);
+        for (int m = 0; m < FORCE_MODES; ++m) modes.push_back(m);
+        grids.push_back(meshSize);
+        sorts.push_back(sortInterval);
+        threads = thread::hardware_concurrency();
+        seed = 1;
+        conservative = false;
+        all = false;
+        csv = false;
+    }
+};
+
+struct BenchResult{
+    int mode;
+    unsigned count;
+    unsigned threads;
+    unsigned grid;          //pm nodes a side, 0 for the other modes
+    unsigned sort;          //steps between morton re-sorts
+    bool skipped;
+    double stepsPerSecond;
+    double nsPerPair;
+    double runMB;           //heap high-water mark of the run, nan when skipped
+    double energyDrift;     //|E_end - E_0| / |E_0|, nan when too big to compute
+    double momentumDrift;   //|P_end - P_0| / sum m|v|
+    double forceError;      //rms relative error of one force pass, nan for exact modes
+    double missesPerStep;   //last level cache misses, nan without perf events
+};
+
+//hardware cache miss counter for this process, threads started after
+//open() are counted too
+struct CacheMisses{
+    int fd;
+
+    CacheMisses(){
+        fd = -1;
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+    ~CacheMisses(){
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+    void start(){
+#ifdef __linux__
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+    double stop(){
+#ifdef __linux__
+        long long count = 0;
+        if (fd >= 0){
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) == sizeof(count)) return count;
+        }
+#endif
+        return NAN;
+    }
+};
+
+//heap held by the process and the most it held since resetHeapPeak(),
+//counted by the operator new below; the size sits in front of each block
+atomic<size_t> heapLive(0);
+atomic<size_t> heapPeak(0);
+enum { HEAP_HEADER = 16 };  //keeps the block aligned for anything
+
+void* operator new(size_t n){
+    size_t* p = (size_t*)malloc(n + HEAP_HEADER);
+    if (!p) throw bad_alloc();
+    p[0] = n;
+    size_t live = heapLive.fetch_add(n, memory_order_relaxed) + n;
+    size_t peak = heapPeak.load(memory_order_relaxed);
+    while (live > peak && !heapPeak.compare_exchange_weak(peak, live, memory_order_relaxed)){}
+    return (char*)p + HEAP_HEADER;
+}
+
+void operator delete(void* q) noexcept{
+    if (!q) return;
+    size_t* p = (size_t*)((char*)q - HEAP_HEADER);
+    heapLive.fetch_sub(p[0], memory_order_relaxed);
+    free(p);
+}
+
+//sized deletes land here from c++14 on, the header knows the size anyway
+void operator delete(void* q, size_t) noexcept{
+    operator delete(q);
+}
+
+size_t resetHeapPeak(){
+    size_t live = heapLive.load(memory_order_relaxed);
+    heapPeak.store(live, memory_order_relaxed);
+    return live;
+}
+
+vector<string> split(const string& s){
+    vector<string> parts;
+    size_t start = 0;
+    while (start <= s.size()){
+        size_t comma = s.find(',', start);
+        if (comma == string::npos) comma = s.size();
+        if (comma > start) parts.push_back(s.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return parts;
+}
+
+//same distribution as Particle(), but from our own generator
+void seed(ParticleSystem& ps, unsigned count, unsigned seedValue){
+    mt19937 gen(seedValue);
+    uniform_real_distribution<float> uniformS(-1, 1);
+    uniform_real_distribution<float> uniform(0, 1);
+    ps.pool.clear();
+    for (unsigned i = 0; i < count; ++i){
+        ParticleHandle h = ps.addParticle();
+        Particle* p = ps.pool.get(h);
+        if (!p) break;
+        p->position = Vec3f(uniformS(gen), uniformS(gen), uniformS(gen)) * initialRadius;
+        p->velocity = Vec3f(0, 1, 0).cross(p->position).normalize(initialSpeed);
+        p->acceleration.zero();
+        p->spring_force.zero();
+        p->lifespan = uniform(gen);
+    }
+}
+
+BenchResult run(const BenchConfig& config, int mode, unsigned count){
+    BenchResult result;
+    result.mode = mode;
+    result.count = count;
+    result.threads = mode == FORCE_PARALLEL || mode == FORCE_PM ? config.threads : 1;
+    result.grid = mode == FORCE_PM ? meshSize : 0;
+    result.sort = sortInterval;
+    result.skipped = false;
+    result.stepsPerSecond = result.nsPerPair = result.runMB = result.energyDrift = result.momentumDrift = result.forceError = result.missesPerStep = NAN;
+
+    double pairs = 0.5 * count * (count - 1.0);
+    bool exact = mode != FORCE_BARNES_HUT && mode != FORCE_PM;
+    if (exact && !config.all && pairs * config.steps > 2e10){
+        result.skipped = true;
+        return result;
+    }
+
+    maxParticles = count;
+    CacheMisses misses;
+    size_t heapBefore = resetHeapPeak();
+    ParticleSystem ps;
+    ps.forceMode = mode;
+    ps.parallel.threads(config.threads);
+    seed(ps, count, config.seed);
+
+    //energy is an exact O(N^2) sum, only for sizes where that is cheap
+    bool measureEnergy = count <= 20000;
+    double e0 = measureEnergy ? ps.energy() : 0;
+    Vec3d p0 = ps.momentum();
+    //force error on the initial state, the mesh samples 1000 bodies, the tree checks all
+    if (mode == FORCE_PM){
+        result.forceError = ps.meshError(1000);
+    } else if (mode == FORCE_BARNES_HUT && measureEnergy){
+        result.forceError = ps.treeError();
+    }
+
+    ps.applyForce(); //first accelerations, like one frame of the app
+    misses.start();
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    for (unsigned s = 0; s < config.steps; ++s){
+        ps.step(timeStep);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    result.missesPerStep = misses.stop() / config.steps;
+
+    result.stepsPerSecond = config.steps / seconds;
+    result.nsPerPair = pairs > 0 ? seconds * 1e9 / config.steps / pairs : 0;
+    //the store's arrays are aligned mallocs and held to the end
+    result.runMB = (heapPeak.load() - heapBefore + ps.store.bytes()) / (1024.0 * 1024.0);
+    if (measureEnergy && e0 != 0){
+        result.energyDrift = fabs(ps.energy() - e0) / fabs(e0);
+    }
+    double scale = 0;
+    for (Particle& p : ps.particles) scale += p.mass * p.velocity.mag();
+    if (scale > 0){
+        result.momentumDrift = (ps.momentum() - p0).mag() / scale;
+    }
+    return result;
+}
+
+void printHeader(bool csv){
+    if (csv){
+        printf("mode,grid,sort,particles,threads,steps_per_sec,ns_per_pair,run_mb,energy_drift,momentum_drift,force_error,misses_per_step\n");
+    } else {
+        printf("%-11s %4s %4s %9s %7s %12s %11s %9s %13s %13s %11s %12s\n", "mode", "grid", "sort", "particles", "threads",
+               "steps/s", "ns/pair", "run MB", "energy drift", "momentum drift", "force err", "misses/step");
+    }
+}
+
+void print(const BenchResult& r, bool csv){
+    if (csv){
+        if (r.skipped){
+            printf("%s,%u,%u,%u,%u,,,,,,,\n", forceModeName[r.mode], r.grid, r.sort, r.count, r.threads);
+        } else {
+            printf("%s,%u,%u,%u,%u,%.4f,%.4f,%.1f,%.6g,%.6g,%.6g,%.6g\n", forceModeName[r.mode], r.grid, r.sort, r.count, r.threads,
+                   r.stepsPerSecond, r.nsPerPair, r.runMB, r.energyDrift, r.momentumDrift, r.forceError, r.missesPerStep);
+        }
+    } else {
+        if (r.skipped){
+            printf("%-11s %4u %4u %9u %7u %12s\n", forceModeName[r.mode], r.grid, r.sort, r.count, r.threads, "skipped");
+        } else {
+            printf("%-11s %4u %4u %9u %7u %12.2f %11.3f %9.1f %13.3g %13.3g %11.3g %12.4g\n", forceModeName[r.mode], r.grid, r.sort,
+                   r.count, r.threads, r.stepsPerSecond, r.nsPerPair, r.runMB, r.energyDrift, r.momentumDrift, r.forceError,
+                   r.missesPerStep);
+        }
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[]){
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i){
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--steps" && hasValue){
+            config.steps = atoi(argv[++i]);
+        } else if (arg == "--counts" && hasValue){
+            config.counts.clear();
+            for (string c : split(argv[++i])) config.counts.push_back(atoi(c.c_str()));
+        } else if (arg == "--modes" && hasValue){
+            config.modes.clear();
+            for (string name : split(argv[++i])){
+                for (int m = 0; m < FORCE_MODES; ++m){
+                    if (name == forceModeName[m]) config.modes.push_back(m);
+                }
+            }
+        } else if (arg == "--threads" && hasValue){
+            config.threads = atoi(argv[++i]);
+        } else if (arg == "--theta" && hasValue){
+            theta = atof(argv[++i]);
+        } else if (arg == "--grids" && hasValue){
+            config.grids.clear();
+            for (string g : split(argv[++i])) config.grids.push_back(atoi(g.c_str()));
+        } else if (arg == "--sorts" && hasValue){
+            config.sorts.clear();
+            for (string n : split(argv[++i])) config.sorts.push_back(atoi(n.c_str()));
+        } else if (arg == "--seed" && hasValue){
+            config.seed = atoi(argv[++i]);
+        } else if (arg == "--conservative"){
+            config.conservative = true;
+        } else if (arg == "--all"){
+            config.all = true;
+        } else if (arg == "--csv"){
+            config.csv = true;
+        } else {
+            fprintf(stderr, "unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (config.threads < 1) config.threads = 1;
+
+    lifeDecaySpeed = 0; //nobody dies during a run, so every step has the same N
+    if (config.conservative){
+        maximumAcceleration = 1e30;
+        spring_k = 0;
+        spring_b = 0;
+        boundary_radius = 1e30;
+        gravityFactor = 10;
+    }
+
+    if (!config.csv){
+        printf("%u steps of %g, theta %g, seed %u%s\n", config.steps, timeStep, theta, config.seed,
+               config.conservative ? ", conservative physics" : "");
+    }
+    printHeader(config.csv);
+    for (unsigned count : config.counts){
+        for (int mode : config.modes){
+            for (unsigned sort : config.sorts){
+                sortInterval = sort;
+                if (mode == FORCE_PM){
+                    for (unsigned grid : config.grids){
+                        meshSize = grid;
+                        print(run(config, mode, count), config.csv);
+                    }
+                } else {
+                    print(run(config, mode, count), config.csv);
+                }
+            }
+        }
+    }
+    return 0;
+}
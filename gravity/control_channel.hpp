@@ -0,0 +1,63 @@
+#ifndef INCLUDE_CONTROL_CHANNEL_HPP
+#define INCLUDE_CONTROL_CHANNEL_HPP
+
+#include <atomic>
+
+using namespace std;
+
+//what the sonification needs from the simulation, reduced once per step
+struct AudioParams{
+    float sp_force_value;
+    float average_velocity_mag;
+
+    AudioParams(){
+        sp_force_value = 0;
+        average_velocity_mag = 0;
+    }
+};
+
+//lock free handoff from one writer thread to one reader thread
+//three copies: the writer fills its own, then swaps it into the middle;
+//the reader swaps the middle out when it is marked fresh. neither side
+//ever waits, and the reader always gets the latest complete value.
+template <typename T>
+struct ControlChannel{
+    T buffers[3];
+    atomic<int> middle;     //index of the middle copy, | FRESH when unread
+    int back;               //writer's copy
+    int front;              //reader's copy
+    enum { FRESH = 4 };
+
+    ControlChannel(){
+        middle.store(1);
+        back = 0;
+        front = 2;
+    }
+
+    //simulation thread
+    void publish(const T& value){
+        buffers[back] = value;
+        back = middle.exchange(back | FRESH, memory_order_acq_rel) & 3;
+    }
+
+    //audio thread, true when value is newer than the last read
+    bool read(T& value){
+        bool fresh = (middle.load(memory_order_relaxed) & FRESH) != 0;
+        if (fresh){
+            front = middle.exchange(front, memory_order_acq_rel) & 3;
+        }
+        value = buffers[front];
+        return fresh;
+    }
+
+    //audio thread, the latest value where it lies, for values too big to
+    //copy every block; good until the next read
+    const T& read(){
+        if (middle.load(memory_order_relaxed) & FRESH){
+            front = middle.exchange(front, memory_order_acq_rel) & 3;
+        }
+        return buffers[front];
+    }
+};
+
+#endif
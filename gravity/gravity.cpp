@@ -1,4 +1,5 @@
 #include "allocore/io/al_App.hpp"
+#include "control_channel.hpp"
 using namespace al;
 using namespace std;
 
@@ -157,6 +158,7 @@ struct Particle {
 struct ParticleSystem {
     vector<Particle> particles;
     Vec3f origin;
+    AudioParams params; //reduced during the force pass
 
     ParticleSystem(){
         origin = Vec3f(0,0,0);
@@ -167,6 +169,12 @@ struct ParticleSystem {
         particles.push_back(p);
     }
     void applyForce(){
+        //the sonification metrics: particle i is done once its row is,
+        //pairs with a lower index came before. the dead ones are reaped
+        //right after, so they are left out
+        double springSum = 0;
+        double velocitySum = 0;
+        unsigned live = 0;
         for (unsigned i = 0; i < particles.size(); ++i){
             for (unsigned j = 1 + i; j < particles.size(); ++j) {
                 Particle& a = particles[i];
@@ -178,7 +186,16 @@ struct ParticleSystem {
                     b.applyForce();
                 }
             }
+            Particle& p = particles[i];
+            if (p.isDead()) continue;
+            Vec3f sf = p.spring_force;
+            Vec3f sfn = sf.normalize();
+            springSum += sf.mag() + sfn.mag() * 0.3;
+            velocitySum += p.velocity.mag();
+            live ++;
         }
+        params.sp_force_value = springSum;
+        params.average_velocity_mag = live > 0 ? velocitySum / live : 0;
     }
     void boundary_detect(){
         for (Particle& p : particles) {
@@ -194,8 +211,14 @@ struct ParticleSystem {
         for (int i = particles.size() - 1; i >= 0; i--){
             Particle& p = particles[i];
             p.draw(g);
-            if (p.isDead()){
-                particles.erase(particles.begin() + i);
+        }
+    }
+    //remove dead particles, the last one fills the hole, O(1) each
+    void reap(){
+        for (int i = particles.size() - 1; i >= 0; i--){
+            if (particles[i].isDead()){
+                particles[i] = particles.back();
+                particles.pop_back();
             }
         }
     }
@@ -235,6 +258,8 @@ struct MyApp : App {
   //audio params
   Phasor phasor;
   Sawtooch saw;
+  ControlChannel<AudioParams> audioChannel;
+  AudioParams audioFrom, audioTo; //ramp across one block
 
   MyApp() {
     //basic settings
@@ -273,8 +298,12 @@ struct MyApp : App {
     //particle system update
     ps.update();
     ps.applyForce();
+    ps.reap();
     ps.boundary_detect();
 
+    //metrics once per step for the audio thread
+    audioChannel.publish(ps.params);
+
     //generator speed control
     if (t < 1) {
         t += dt * generator_speed;
@@ -298,9 +327,14 @@ struct MyApp : App {
 
   void onSound(AudioIOData& io) {
      //io(); // means ready yourself for the next sample set
+    audioFrom = audioTo;
+    audioChannel.read(audioTo);
+    float frames = io.framesPerBuffer();
+    float frame = 0;
     while (io()) {
-    phasor.frequency(20 * ps.sp_force_value(), 44100);
-    saw.frequency(ps.average_velocity_mag() * 5,44100);
+    float ramp = ++frame / frames;
+    phasor.frequency(20 * (audioFrom.sp_force_value + (audioTo.sp_force_value - audioFrom.sp_force_value) * ramp), 44100);
+    saw.frequency((audioFrom.average_velocity_mag + (audioTo.average_velocity_mag - audioFrom.average_velocity_mag) * ramp) * 5,44100);
     float s = phasor() * 0.3 + saw() * 0.08;
       
         io.out(0) = s;
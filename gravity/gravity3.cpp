@@ -198,8 +198,14 @@ struct ParticleSystem {
         for (int i = particles.size() - 1; i >= 0; i--){
             Particle& p = particles[i];
             p.draw(g);
-            if (p.isDead()){
-                particles.erase(particles.begin() + i);
+        }
+    }
+    //remove dead particles, the last one fills the hole, O(1) each
+    void reap(){
+        for (int i = particles.size() - 1; i >= 0; i--){
+            if (particles[i].isDead()){
+                particles[i] = particles.back();
+                particles.pop_back();
             }
         }
     }
@@ -256,6 +262,7 @@ struct MyApp : App {
     //particle system update
     ps.update();
     ps.applyForce();
+    ps.reap();
     ps.boundary_detect();
 
     //generator speed control
@@ -0,0 +1,146 @@
+#ifndef INCLUDE_MORTON_ORDER_HPP
+#define INCLUDE_MORTON_ORDER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include "allocore/io/al_App.hpp"
+#include "thread_pool.hpp"
+
+using namespace al;
+using namespace std;
+
+//z-order (morton) sort of bodies by position
+//bodies close in space end up close in memory, so neighbour walks, tree
+//builds and the grid touch fewer cache lines. the code interleaves 10 bits
+//of x, y and z over the bounding box; sorted with a stable lsd radix sort,
+//3 passes of 11 bits, each pass split between the pool's threads.
+//order[k] is the old index of what is now at k, rank[i] is where old i went.
+
+struct MortonOrder{
+    vector<uint64_t> keys;              //code << 32 | old index
+    vector<uint64_t> scratch;
+    vector<vector<unsigned> > counts;   //per thread digit histograms
+    vector<unsigned> order;
+    vector<unsigned> rank;
+    vector<unsigned> moved;             //scratch for apply()
+    enum { DIGIT_BITS = 11, DIGITS = 1 << DIGIT_BITS, PASSES = 3 };
+
+    //10 bits spread to every third bit
+    static uint32_t spread(uint32_t v){
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+    static uint32_t code(const Vec3f& p, const Vec3f& lo, float scale){
+        uint32_t c[3];
+        for (unsigned a = 0; a < 3; ++a){
+            float u = (p[a] - lo[a]) * scale;
+            c[a] = u <= 0 ? 0 : u >= 1023 ? 1023 : (uint32_t)u;
+        }
+        return spread(c[0]) | (spread(c[1]) << 1) | (spread(c[2]) << 2);
+    }
+
+    //anything with .position works as a body; pool may be 0 for a small sort
+    template <typename Body>
+    void sort(const vector<Body>& bodies, ThreadPool* pool = 0){
+        sort(bodies.size(), [&](unsigned i) -> const Vec3f& { return bodies[i].position; }, pool);
+    }
+
+    template <typename Position>
+    void sort(unsigned n, Position position, ThreadPool* pool = 0){
+        order.resize(n);
+        rank.resize(n);
+        if (n == 0) return;
+        Vec3f lo = position(0), hi = position(0);
+        for (unsigned i = 1; i < n; ++i){
+            const Vec3f& p = position(i);
+            for (unsigned a = 0; a < 3; ++a){
+                if (p[a] < lo[a]) lo[a] = p[a];
+                if (p[a] > hi[a]) hi[a] = p[a];
+            }
+        }
+        float extent = max(hi.x - lo.x, max(hi.y - lo.y, hi.z - lo.z));
+        float scale = extent > 0 ? 1023.99f / extent : 0;
+
+        //threads only pay off past a few thousand bodies
+        unsigned threads = pool && n > 4096 ? pool->size() : 1;
+        keys.resize(n);
+        scratch.resize(n);
+        counts.resize(threads);
+        for (vector<unsigned>& c : counts) c.assign(DIGITS, 0);
+        each(threads, pool, [&](unsigned t){
+            unsigned i0 = (unsigned long)n * t / threads, i1 = (unsigned long)n * (t + 1) / threads;
+            for (unsigned i = i0; i < i1; ++i){
+                keys[i] = (uint64_t)code(position(i), lo, scale) << 32 | i;
+            }
+        });
+
+        for (unsigned pass = 0; pass < PASSES; ++pass){
+            unsigned shift = 32 + pass * DIGIT_BITS;
+            //every thread counts its own slice
+            each(threads, pool, [&](unsigned t){
+                unsigned i0 = (unsigned long)n * t / threads, i1 = (unsigned long)n * (t + 1) / threads;
+                unsigned* c = &counts[t][0];
+                for (unsigned d = 0; d < DIGITS; ++d) c[d] = 0;
+                for (unsigned i = i0; i < i1; ++i){
+                    c[(keys[i] >> shift) & (DIGITS - 1)] ++;
+                }
+            });
+            //digit major, thread minor offsets keep the sort stable
+            unsigned sum = 0;
+            for (unsigned d = 0; d < DIGITS; ++d){
+                for (unsigned t = 0; t < threads; ++t){
+                    unsigned c = counts[t][d];
+                    counts[t][d] = sum;
+                    sum += c;
+                }
+            }
+            each(threads, pool, [&](unsigned t){
+                unsigned i0 = (unsigned long)n * t / threads, i1 = (unsigned long)n * (t + 1) / threads;
+                unsigned* c = &counts[t][0];
+                for (unsigned i = i0; i < i1; ++i){
+                    scratch[c[(keys[i] >> shift) & (DIGITS - 1)] ++] = keys[i];
+                }
+            });
+            keys.swap(scratch);
+        }
+
+        for (unsigned k = 0; k < n; ++k){
+            order[k] = (unsigned)keys[k];
+            rank[order[k]] = k;
+        }
+    }
+
+    template <typename Job>
+    static void each(unsigned threads, ThreadPool* pool, Job job){
+        if (threads == 1){
+            job(0);
+        } else {
+            pool->run([&](unsigned t){ if (t < threads) job(t); });
+        }
+    }
+
+    //moves items into the last sorted order, in place by following cycles
+    template <typename T>
+    void apply(vector<T>& items){
+        vector<unsigned>& done = moved;
+        done.assign(items.size(), 0);
+        for (unsigned k = 0; k < items.size(); ++k){
+            if (done[k]) continue;
+            //k takes from order[k], which takes from order[order[k]]...
+            unsigned j = k;
+            while (order[j] != k){
+                swap(items[j], items[order[j]]);
+                done[j] = 1;
+                j = order[j];
+            }
+            done[j] = 1;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef INCLUDE_OCTREE_HPP
+#define INCLUDE_OCTREE_HPP
+
+#include <vector>
+#include <cmath>
+#include "allocore/io/al_App.hpp"
+
+using namespace al;
+using namespace std;
+
+//Barnes-Hut octree over particle positions
+//rebuilt every step; a cell that looks small enough from where a particle
+//stands (size / distance < theta) is treated as one body at its center of
+//mass, so the whole force pass costs O(N log N) instead of O(N^2)
+
+struct OctreeNode{
+    Vec3f center;       //geometric center of the cell
+    float halfSize;
+    float mass;         //total mass below this cell
+    Vec3f moment;       //mass weighted position sum, center of mass = moment / mass
+    int firstChild;     //8 children are stored next to each other, -1 for a leaf
+    int firstBody;      //head of the body list of a leaf, -1 when empty
+    int count;
+
+    OctreeNode(){
+        halfSize = 0;
+        mass = 0;
+        firstChild = -1;
+        firstBody = -1;
+        count = 0;
+    }
+};
+
+struct Octree{
+    vector<OctreeNode> nodes;
+    vector<Vec3f> pos;      //compact copy of positions taken at build time
+    vector<float> mass;
+    vector<int> next;       //body list links inside a leaf
+    float theta;            //opening angle, 0 = exact, 0.5 ~ 1% error, 1.0 = fast and rough
+    int leafSize;           //bodies a leaf holds before it splits
+    int maxDepth;           //stops splitting coincident particles forever
+
+    Octree(){
+        theta = 0.5;
+        leafSize = 4;
+        maxDepth = 24;
+    }
+
+    //anything with .position and .mass works as a body
+    template <typename Body>
+    void build(const vector<Body>& bodies){
+        nodes.clear();
+        pos.resize(bodies.size());
+        mass.resize(bodies.size());
+        next.assign(bodies.size(), -1);
+        if (bodies.empty()) return;
+
+        //bounding cube
+        Vec3f lo = bodies[0].position;
+        Vec3f hi = bodies[0].position;
+        for (unsigned i = 0; i < bodies.size(); ++i){
+            pos[i] = bodies[i].position;
+            mass[i] = bodies[i].mass;
+            for (int k = 0; k < 3; ++k){
+                if (pos[i][k] < lo[k]) lo[k] = pos[i][k];
+                if (pos[i][k] > hi[k]) hi[k] = pos[i][k];
+            }
+        }
+        float extent = 0;
+        for (int k = 0; k < 3; ++k){
+            if (hi[k] - lo[k] > extent) extent = hi[k] - lo[k];
+        }
+        OctreeNode root;
+        root.center = (lo + hi) * 0.5;
+        root.halfSize = extent * 0.5 + 1e-3;
+        nodes.reserve(bodies.size() * 2 + 1);
+        nodes.push_back(root);
+
+        for (unsigned i = 0; i < bodies.size(); ++i){
+            insert(i);
+        }
+    }
+
+    int octant(const Vec3f& center, const Vec3f& p) const {
+        return (p.x > center.x ? 1 : 0) | (p.y > center.y ? 2 : 0) | (p.z > center.z ? 4 : 0);
+    }
+
+    void addToNode(int n, int i){
+        nodes[n].mass += mass[i];
+        nodes[n].moment += pos[i] * mass[i];
+        nodes[n].count ++;
+    }
+
+    void insert(int i){
+        int n = 0;
+        int depth = 0;
+        while (true){
+            addToNode(n, i);
+            if (nodes[n].firstChild < 0){
+                if (nodes[n].count <= leafSize || depth >= maxDepth){
+                    next[i] = nodes[n].firstBody;
+                    nodes[n].firstBody = i;
+                    return;
+                }
+                split(n);
+            }
+            n = nodes[n].firstChild + octant(nodes[n].center, pos[i]);
+            depth ++;
+        }
+    }
+
+    //turns a full leaf into 8 children and hands its bodies down
+    void split(int n){
+        int base = nodes.size();
+        float h = nodes[n].halfSize * 0.5;
+        Vec3f c = nodes[n].center;
+        for (int k = 0; k < 8; ++k){
+            OctreeNode child;
+            child.center = c + Vec3f(k & 1 ? h : -h, k & 2 ? h : -h, k & 4 ? h : -h);
+            child.halfSize = h;
+            nodes.push_back(child);
+        }
+        nodes[n].firstChild = base;
+        int b = nodes[n].firstBody;
+        nodes[n].firstBody = -1;
+        while (b >= 0){
+            int nb = next[b];
+            int k = base + octant(c, pos[b]);
+            addToNode(k, b);
+            next[b] = nodes[k].firstBody;
+            nodes[k].firstBody = b;
+            b = nb;
+        }
+    }
+
+    //gravitational acceleration on body i, F = G * m / d^2 toward the source
+    //cells closer than nearRadius are always opened, and every body found in
+    //an opened leaf is passed to near(j) for exact short range work (springs)
+    template <typename Near>
+    Vec3f gravity(int i, double G, float nearRadius, Near near) const {
+        Vec3f a(0,0,0);
+        if (nodes.empty()) return a;
+        const Vec3f& p = pos[i];
+        const float diagonal = sqrt(3.0f);
+        int stack[256];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0){
+            const OctreeNode& node = nodes[stack[--top]];
+            if (node.count == 0) continue;
+
+            if (node.firstChild < 0){
+                //leaf: exact interaction with every body in it
+                for (int j = node.firstBody; j >= 0; j = next[j]){
+                    if (j == i) continue;
+                    Vec3f difference = pos[j] - p;
+                    double d = difference.mag();
+                    if (d <= 0) continue;
+                    a += difference / (d * d * d) * G * mass[j];
+                    near(j);
+                }
+                continue;
+            }
+
+            //far enough, and nothing inside can touch us: use the center of mass
+            float size = node.halfSize * 2;
+            double boxDistance = (node.center - p).mag() - node.halfSize * diagonal;
+            if (boxDistance > nearRadius){
+                Vec3f com = node.moment / node.mass;
+                Vec3f difference = com - p;
+                double d = difference.mag();
+                if (size < theta * d){
+                    a += difference / (d * d * d) * G * node.mass;
+                    continue;
+                }
+            }
+            for (int k = 7; k >= 0; --k){
+                if (nodes[node.firstChild + k].count > 0 && top < 256){
+                    stack[top++] = node.firstChild + k;
+                }
+            }
+        }
+        return a;
+    }
+};
+
+#endif
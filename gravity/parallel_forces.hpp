@@ -0,0 +1,230 @@
+#ifndef INCLUDE_PARALLEL_FORCES_HPP
+#define INCLUDE_PARALLEL_FORCES_HPP
+
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include "particle_store.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+//the same kernel for 8 (avx) or 4 (sse) lanes
+#if defined(__AVX__)
+#define PF_LANES 8
+typedef __m256 pf_lanes;
+#define PF_SET1 _mm256_set1_ps
+#define PF_LOAD _mm256_load_ps
+#define PF_LOADU _mm256_loadu_ps
+#define PF_STOREU _mm256_storeu_ps
+#define PF_ADD _mm256_add_ps
+#define PF_SUB _mm256_sub_ps
+#define PF_MUL _mm256_mul_ps
+#define PF_DIV _mm256_div_ps
+#define PF_SQRT _mm256_sqrt_ps
+#define PF_AND _mm256_and_ps
+#define PF_GT(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define PF_LT(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define PF_ANY _mm256_movemask_ps
+#define PF_INDEX(j) _mm256_set_ps(j + 7, j + 6, j + 5, j + 4, j + 3, j + 2, j + 1, j)
+#elif defined(__SSE__) || defined(_M_X64)
+#define PF_LANES 4
+typedef __m128 pf_lanes;
+#define PF_SET1 _mm_set1_ps
+#define PF_LOAD _mm_load_ps
+#define PF_LOADU _mm_loadu_ps
+#define PF_STOREU _mm_storeu_ps
+#define PF_ADD _mm_add_ps
+#define PF_SUB _mm_sub_ps
+#define PF_MUL _mm_mul_ps
+#define PF_DIV _mm_div_ps
+#define PF_SQRT _mm_sqrt_ps
+#define PF_AND _mm_and_ps
+#define PF_GT _mm_cmpgt_ps
+#define PF_LT _mm_cmplt_ps
+#define PF_ANY _mm_movemask_ps
+#define PF_INDEX(j) _mm_set_ps(j + 3, j + 2, j + 1, j)
+#endif
+
+//exact all-pairs gravity + springs on every core
+//the i <= j triangle is cut into tile x tile blocks, each pair is computed
+//once and applied to both ends (newton's third law). blocks are dealt to
+//threads round robin in a fixed order, every thread sums into its own
+//accumulators, and the reduction adds threads in order 0, 1, 2...
+//so for a given thread count the result is bitwise the same every run.
+
+struct ParallelForces{
+    ThreadPool pool;
+    unsigned tile;
+    vector<vector<float> > accum;   //per thread: ax ay az sx sy sz, padded long each
+    vector<unsigned> tileI, tileJ;  //the triangle of blocks, in dealing order
+    unsigned stride;
+
+    //timings of the last step in milliseconds
+    double forceMs;
+    double reduceMs;
+
+    ParallelForces(){
+        tile = 256;
+        stride = 0;
+        forceMs = 0;
+        reduceMs = 0;
+    }
+
+    void threads(unsigned n){
+        pool.resize(n);
+    }
+    unsigned threads() const {
+        return pool.size();
+    }
+
+    void prepare(const ParticleStore& s){
+        unsigned blocks = (s.count + tile - 1) / tile;
+        tileI.clear();
+        tileJ.clear();
+        for (unsigned bi = 0; bi < blocks; ++bi){
+            for (unsigned bj = bi; bj < blocks; ++bj){
+                tileI.push_back(bi);
+                tileJ.push_back(bj);
+            }
+        }
+        stride = s.padded;
+        accum.resize(pool.size());
+        for (vector<float>& a : accum){
+            a.assign(stride * 6, 0);
+        }
+    }
+
+#ifdef PF_LANES
+    //pairs (i, j) with i in [i0, i1), j in [j0, j1) and j > i
+    //j1 may run into the padding, those partners are massless and far away
+    static void block(const ParticleStore& s, float* a, unsigned stride,
+                      unsigned i0, unsigned i1, unsigned j0, unsigned j1,
+                      float G, float min2, float k, float b){
+        float* ax = a;
+        float* ay = a + stride;
+        float* az = a + stride * 2;
+        float* sx = a + stride * 3;
+        float* sy = a + stride * 4;
+        float* sz = a + stride * 5;
+        j1 = (j1 + PF_LANES - 1) & ~(PF_LANES - 1);
+        pf_lanes g = PF_SET1(G), m2 = PF_SET1(min2), kk = PF_SET1(k), bb = PF_SET1(b), zero = PF_SET1(0);
+        for (unsigned i = i0; i < i1; ++i){
+            pf_lanes xi = PF_SET1(s.x[i]), yi = PF_SET1(s.y[i]), zi = PF_SET1(s.z[i]);
+            pf_lanes vxi = PF_SET1(s.vx[i]), vyi = PF_SET1(s.vy[i]), vzi = PF_SET1(s.vz[i]);
+            pf_lanes mi = PF_SET1(s.mass[i]), index = PF_SET1((float)i);
+            pf_lanes pax = zero, pay = zero, paz = zero, psx = zero, psy = zero, psz = zero;
+            unsigned start = (j0 > i + 1 ? j0 : i + 1) & ~(PF_LANES - 1);
+            for (unsigned j = start; j < j1; j += PF_LANES){
+                pf_lanes dx = PF_SUB(PF_LOAD(s.x + j), xi);
+                pf_lanes dy = PF_SUB(PF_LOAD(s.y + j), yi);
+                pf_lanes dz = PF_SUB(PF_LOAD(s.z + j), zi);
+                pf_lanes d2 = PF_ADD(PF_ADD(PF_MUL(dx, dx), PF_MUL(dy, dy)), PF_MUL(dz, dz));
+                pf_lanes live = PF_AND(PF_GT(PF_INDEX((float)j), index), PF_GT(d2, zero));
+                pf_lanes inv = PF_AND(live, PF_DIV(g, PF_MUL(d2, PF_SQRT(d2))));
+                pf_lanes gi = PF_MUL(inv, PF_LOAD(s.mass + j));
+                pf_lanes gj = PF_MUL(inv, mi);
+                pax = PF_ADD(pax, PF_MUL(dx, gi));
+                pay = PF_ADD(pay, PF_MUL(dy, gi));
+                paz = PF_ADD(paz, PF_MUL(dz, gi));
+                PF_STOREU(ax + j, PF_SUB(PF_LOADU(ax + j), PF_MUL(dx, gj)));
+                PF_STOREU(ay + j, PF_SUB(PF_LOADU(ay + j), PF_MUL(dy, gj)));
+                PF_STOREU(az + j, PF_SUB(PF_LOADU(az + j), PF_MUL(dz, gj)));
+                pf_lanes touch = PF_AND(live, PF_LT(d2, m2));
+                if (PF_ANY(touch)){
+                    //f = -d * k - (v_i - v_j) * b, the partner gets -f
+                    pf_lanes fx = PF_AND(touch, PF_ADD(PF_MUL(dx, kk), PF_MUL(PF_SUB(vxi, PF_LOAD(s.vx + j)), bb)));
+                    pf_lanes fy = PF_AND(touch, PF_ADD(PF_MUL(dy, kk), PF_MUL(PF_SUB(vyi, PF_LOAD(s.vy + j)), bb)));
+                    pf_lanes fz = PF_AND(touch, PF_ADD(PF_MUL(dz, kk), PF_MUL(PF_SUB(vzi, PF_LOAD(s.vz + j)), bb)));
+                    psx = PF_SUB(psx, fx);
+                    psy = PF_SUB(psy, fy);
+                    psz = PF_SUB(psz, fz);
+                    PF_STOREU(sx + j, PF_ADD(PF_LOADU(sx + j), fx));
+                    PF_STOREU(sy + j, PF_ADD(PF_LOADU(sy + j), fy));
+                    PF_STOREU(sz + j, PF_ADD(PF_LOADU(sz + j), fz));
+                }
+            }
+            ax[i] += ParticleStore::hsum(pax); ay[i] += ParticleStore::hsum(pay); az[i] += ParticleStore::hsum(paz);
+            sx[i] += ParticleStore::hsum(psx); sy[i] += ParticleStore::hsum(psy); sz[i] += ParticleStore::hsum(psz);
+        }
+    }
+#else
+    //pairs (i, j) with i in [i0, i1), j in [j0, j1) and j > i
+    static void block(const ParticleStore& s, float* a, unsigned stride,
+                      unsigned i0, unsigned i1, unsigned j0, unsigned j1,
+                      float G, float min2, float k, float b){
+        float* ax = a;
+        float* ay = a + stride;
+        float* az = a + stride * 2;
+        float* sx = a + stride * 3;
+        float* sy = a + stride * 4;
+        float* sz = a + stride * 5;
+        for (unsigned i = i0; i < i1; ++i){
+            float xi = s.x[i], yi = s.y[i], zi = s.z[i];
+            float vxi = s.vx[i], vyi = s.vy[i], vzi = s.vz[i];
+            float mi = s.mass[i];
+            float pax = 0, pay = 0, paz = 0, psx = 0, psy = 0, psz = 0;
+            for (unsigned j = (j0 > i + 1 ? j0 : i + 1); j < j1; ++j){
+                float dx = s.x[j] - xi, dy = s.y[j] - yi, dz = s.z[j] - zi;
+                float d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 <= 0) continue;
+                float inv = G / (d2 * sqrtf(d2));
+                float gi = inv * s.mass[j];
+                float gj = inv * mi;
+                pax += dx * gi; pay += dy * gi; paz += dz * gi;
+                ax[j] -= dx * gj; ay[j] -= dy * gj; az[j] -= dz * gj;
+                if (d2 < min2){
+                    float fx = -dx * k - (vxi - s.vx[j]) * b;
+                    float fy = -dy * k - (vyi - s.vy[j]) * b;
+                    float fz = -dz * k - (vzi - s.vz[j]) * b;
+                    psx += fx; psy += fy; psz += fz;
+                    sx[j] -= fx; sy[j] -= fy; sz[j] -= fz;
+                }
+            }
+            ax[i] += pax; ay[i] += pay; az[i] += paz;
+            sx[i] += psx; sy[i] += psy; sz[i] += psz;
+        }
+    }
+#endif
+
+    //fills s.ax.. s.sz, same meaning as ParticleStore::allPairs
+    void run(ParticleStore& s, float G, float minDistance, float k, float b){
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        prepare(s);
+        unsigned n = pool.size();
+        float min2 = minDistance * minDistance;
+        unsigned count = s.count;
+
+        pool.run([&](unsigned t){
+            float* a = &accum[t][0];
+            for (unsigned w = t; w < tileI.size(); w += n){
+                unsigned i0 = tileI[w] * tile, j0 = tileJ[w] * tile;
+                unsigned i1 = i0 + tile < count ? i0 + tile : count;
+                unsigned j1 = j0 + tile < count ? j0 + tile : count;
+                block(s, a, stride, i0, i1, j0, j1, G, min2, k, b);
+            }
+        });
+        chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+
+        //reduce, particles split between threads, threads summed in order
+        float* out[6] = { s.ax, s.ay, s.az, s.sx, s.sy, s.sz };
+        pool.run([&](unsigned t){
+            unsigned i0 = (unsigned long)count * t / n;
+            unsigned i1 = (unsigned long)count * (t + 1) / n;
+            for (unsigned c = 0; c < 6; ++c){
+                for (unsigned i = i0; i < i1; ++i){
+                    float sum = 0;
+                    for (unsigned u = 0; u < n; ++u){
+                        sum += accum[u][c * stride + i];
+                    }
+                    out[c][i] = sum;
+                }
+            }
+        });
+        chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+        forceMs = chrono::duration<double, milli>(t1 - t0).count();
+        reduceMs = chrono::duration<double, milli>(t2 - t1).count();
+    }
+};
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef INCLUDE_PARTICLE_MESH_HPP
+#define INCLUDE_PARTICLE_MESH_HPP
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <chrono>
+#include "allocore/io/al_App.hpp"
+#include "thread_pool.hpp"
+
+using namespace al;
+using namespace std;
+
+//particle-mesh gravity, O(N + M log M) for M grid nodes
+//mass goes onto a size^3 grid of nodes with cloud-in-cell weights, the
+//potential is the mass convolved with -G / r, done as a product of ffts,
+//the field is its central difference, and each body reads the field back
+//with the same cloud-in-cell weights (so there is no self force).
+//the grid is zero padded to 2 * size a side, which turns the fft's periodic
+//convolution into an isolated one: no ghost images of the system.
+//forces are softened below a couple of grid spacings; springs and close
+//encounters are for the short range path.
+
+typedef complex<float> pm_complex;
+
+struct ParticleMesh{
+    unsigned size;              //nodes a side, power of two
+    unsigned padded;            //2 * size
+    Vec3f center;
+    float extent;               //the grid covers center +- extent on every axis
+    float spacing;
+    vector<pm_complex> field;   //padded^3, mass then potential
+    vector<float> green;        //padded^3, fft of -1 / r in grid units, real since the kernel is even
+    vector<float> gx, gy, gz;   //size^3, acceleration at the nodes
+    vector<pm_complex> twiddle;
+    vector<unsigned> bitrev;
+    vector<vector<pm_complex> > lines; //per thread scratch for strided axes
+
+    //timings of the last solve in milliseconds
+    double depositMs;
+    double fftMs;               //both transforms and the product between them
+    double gradientMs;
+
+    ParticleMesh(){
+        size = 0;
+        padded = 0;
+        center = Vec3f(0, 0, 0);
+        extent = 1;
+        spacing = 1;
+        depositMs = 0;
+        fftMs = 0;
+        gradientMs = 0;
+    }
+
+    unsigned at(unsigned x, unsigned y, unsigned z) const {
+        return (z * padded + y) * padded + x;
+    }
+    unsigned node(unsigned x, unsigned y, unsigned z) const {
+        return (z * size + y) * size + x;
+    }
+
+    void resize(unsigned n, ThreadPool& pool){
+        if (n < 4) n = 4;
+        unsigned p = 4;
+        while (p < n) p *= 2;
+        if (p == size) return;
+        size = p;
+        padded = size * 2;
+
+        twiddle.resize(padded / 2);
+        for (unsigned k = 0; k < padded / 2; ++k){
+            double a = -2 * M_PI * k / padded;
+            twiddle[k] = pm_complex(cos(a), sin(a));
+        }
+        bitrev.resize(padded);
+        unsigned bits = 0;
+        while ((1u << bits) < padded) bits ++;
+        for (unsigned i = 0; i < padded; ++i){
+            unsigned r = 0;
+            for (unsigned b = 0; b < bits; ++b){
+                if (i & (1u << b)) r |= 1u << (bits - 1 - b);
+            }
+            bitrev[i] = r;
+        }
+
+        field.assign((size_t)padded * padded * padded, pm_complex(0, 0));
+        gx.assign((size_t)size * size * size, 0);
+        gy.assign(gx.size(), 0);
+        gz.assign(gx.size(), 0);
+
+        //green's function in grid units, distances wrap so the kernel is even
+        //the self cell gets -1, as if the mass were a node away
+        for (unsigned z = 0; z < padded; ++z){
+            float dz = z < padded - z ? z : padded - z;
+            for (unsigned y = 0; y < padded; ++y){
+                float dy = y < padded - y ? y : padded - y;
+                for (unsigned x = 0; x < padded; ++x){
+                    float dx = x < padded - x ? x : padded - x;
+                    float r = sqrtf(dx * dx + dy * dy + dz * dz);
+                    field[at(x, y, z)] = pm_complex(r > 0 ? -1 / r : -1, 0);
+                }
+            }
+        }
+        transform(pool, false, false);
+        green.resize(field.size());
+        for (size_t i = 0; i < field.size(); ++i){
+            green[i] = field[i].real();
+        }
+    }
+
+    //in place radix 2, e^-i forward, e^+i inverse (unscaled)
+    //complex products written out, std::complex goes through a slow
+    //nan checking path without -ffast-math
+    void fft(pm_complex* a, bool inverse) const {
+        unsigned n = padded;
+        for (unsigned i = 0; i < n; ++i){
+            unsigned j = bitrev[i];
+            if (i < j) swap(a[i], a[j]);
+        }
+        float sign = inverse ? -1 : 1;
+        float* f = reinterpret_cast<float*>(a);
+        for (unsigned len = 2; len <= n; len *= 2){
+            unsigned half = len / 2;
+            unsigned step = n / len;
+            for (unsigned k = 0; k < half; ++k){
+                float wr = twiddle[k * step].real();
+                float wi = twiddle[k * step].imag() * sign;
+                for (unsigned i = k; i < n; i += len){
+                    float* u = f + 2 * i;
+                    float* v = f + 2 * (i + half);
+                    float vr = v[0] * wr - v[1] * wi;
+                    float vi = v[0] * wi + v[1] * wr;
+                    v[0] = u[0] - vr;
+                    v[1] = u[1] - vi;
+                    u[0] += vr;
+                    u[1] += vi;
+                }
+            }
+        }
+    }
+
+    //3d fft of field, one axis at a time, lines split between threads
+    //lines along y and z are gathered lineBatch at a time, neighbours in x,
+    //so the strided reads still use whole cache lines
+    //with pruned set the padding is known to be zero (forward) or unused
+    //(inverse), and lines that are all padding are skipped
+    enum { lineBatch = 8 };
+    void transform(ThreadPool& pool, bool inverse, bool pruned){
+        unsigned n = pool.size();
+        lines.resize(n);
+        for (vector<pm_complex>& l : lines) l.resize(padded * lineBatch);
+        //forward runs x, y, z; inverse runs z, y, x
+        for (unsigned pass = 0; pass < 3; ++pass){
+            unsigned axis = inverse ? 2 - pass : pass;
+            //lines are indexed by the two other coordinates (u, v), u is x
+            //for the y and z passes. forward, the first passes only see
+            //padding outside size; inverse, we only read back nodes -1 .. size
+            unsigned uLimit = padded, vLimit = padded;
+            if (pruned && !inverse){
+                if (axis == 0){ uLimit = size; vLimit = size; }
+                if (axis == 1){ vLimit = size; }
+            }
+            unsigned batch = axis == 0 ? 1 : lineBatch;
+            unsigned uBatches = (uLimit + batch - 1) / batch;
+            pool.run([&, axis, uLimit, vLimit, batch, uBatches](unsigned t){
+                pm_complex* line = &lines[t][0];
+                unsigned total = uBatches * vLimit;
+                for (unsigned w = t; w < total; w += n){
+                    unsigned u0 = (w % uBatches) * batch, v = w / uBatches;
+                    if (axis == 0){
+                        if (pruned && inverse && !(readBack(u0) && readBack(v))) continue;
+                        fft(&field[at(0, u0, v)], inverse);
+                        continue;
+                    }
+                    if (pruned && inverse && axis == 1 && !readBack(v)) continue;
+                    unsigned count = u0 + batch < uLimit ? batch : uLimit - u0;
+                    size_t start = axis == 1 ? at(u0, 0, v) : at(u0, v, 0);
+                    size_t stride = axis == 1 ? padded : (size_t)padded * padded;
+                    for (unsigned i = 0; i < padded; ++i){
+                        const pm_complex* src = &field[start + i * stride];
+                        for (unsigned b = 0; b < count; ++b) line[b * padded + i] = src[b];
+                    }
+                    for (unsigned b = 0; b < count; ++b) fft(line + b * padded, inverse);
+                    for (unsigned i = 0; i < padded; ++i){
+                        pm_complex* dst = &field[start + i * stride];
+                        for (unsigned b = 0; b < count; ++b) dst[b] = line[b * padded + i];
+                    }
+                }
+            });
+        }
+    }
+    //coordinate c of the inverse output is read back by the central difference;
+    //the inverse does z over everything, then y on those planes, then x on those rows
+    bool readBack(unsigned c) const {
+        return c <= size || c == padded - 1;
+    }
+
+    //anything with .position and .mass works as a body
+    template <typename Body>
+    void solve(const vector<Body>& bodies, double G, const Vec3f& c, float halfWidth, ThreadPool& pool){
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        center = c;
+        extent = halfWidth;
+        spacing = 2 * extent / (size - 1);
+        fill(field.begin(), field.end(), pm_complex(0, 0));
+        for (const Body& b : bodies){
+            unsigned x, y, z;
+            float w[6];
+            weights(b.position, x, y, z, w);
+            float m = b.mass;
+            for (unsigned c = 0; c < 8; ++c){
+                float wc = w[c & 1] * w[2 + ((c >> 1) & 1)] * w[4 + (c >> 2)];
+                field[at(x + (c & 1), y + ((c >> 1) & 1), z + (c >> 2))] += pm_complex(m * wc, 0);
+            }
+        }
+        chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+
+        transform(pool, false, true);
+        unsigned nt = pool.size();
+        pool.run([&](unsigned t){
+            for (size_t i = t; i < field.size(); i += nt){
+                field[i] *= green[i];
+            }
+        });
+        transform(pool, true, true);
+        chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+
+        //a = -grad phi, phi = G / spacing * ifft / padded^3
+        float scale = G / spacing / ((double)padded * padded * padded) / (2 * spacing);
+        unsigned last = padded - 1;
+        pool.run([&](unsigned t){
+            for (unsigned z = t; z < size; z += nt){
+                unsigned zm = z == 0 ? last : z - 1;
+                for (unsigned y = 0; y < size; ++y){
+                    unsigned ym = y == 0 ? last : y - 1;
+                    for (unsigned x = 0; x < size; ++x){
+                        unsigned xm = x == 0 ? last : x - 1;
+                        unsigned i = node(x, y, z);
+                        gx[i] = -scale * (field[at(x + 1, y, z)].real() - field[at(xm, y, z)].real());
+                        gy[i] = -scale * (field[at(x, y + 1, z)].real() - field[at(x, ym, z)].real());
+                        gz[i] = -scale * (field[at(x, y, z + 1)].real() - field[at(x, y, zm)].real());
+                    }
+                }
+            }
+        });
+        chrono::steady_clock::time_point t3 = chrono::steady_clock::now();
+        depositMs = chrono::duration<double, milli>(t1 - t0).count();
+        fftMs = chrono::duration<double, milli>(t2 - t1).count();
+        gradientMs = chrono::duration<double, milli>(t3 - t2).count();
+    }
+
+    //lower node and cloud-in-cell weights (1 - f, f) per axis
+    void weights(const Vec3f& p, unsigned& x, unsigned& y, unsigned& z, float* w) const {
+        unsigned* index[3] = { &x, &y, &z };
+        for (unsigned a = 0; a < 3; ++a){
+            float u = (p[a] - center[a] + extent) / spacing;
+            float lower = floorf(u);
+            if (lower < 0) lower = 0;
+            if (lower > size - 2) lower = size - 2;
+            float f = u - lower;
+            if (f < 0) f = 0;
+            if (f > 1) f = 1;
+            *index[a] = (unsigned)lower;
+            w[a * 2] = 1 - f;
+            w[a * 2 + 1] = f;
+        }
+    }
+
+    //field at p, same weights as the deposit
+    Vec3f acceleration(const Vec3f& p) const {
+        unsigned x, y, z;
+        float w[6];
+        weights(p, x, y, z, w);
+        Vec3f a(0, 0, 0);
+        for (unsigned c = 0; c < 8; ++c){
+            float wc = w[c & 1] * w[2 + ((c >> 1) & 1)] * w[4 + (c >> 2)];
+            unsigned i = node(x + (c & 1), y + ((c >> 1) & 1), z + (c >> 2));
+            a += Vec3f(gx[i], gy[i], gz[i]) * wc;
+        }
+        return a;
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef INCLUDE_PARTICLE_POOL_HPP
+#define INCLUDE_PARTICLE_POOL_HPP
+
+#include <vector>
+
+using namespace std;
+
+//stable reference to a pooled item
+//items move around when others die; a handle goes through the slot table,
+//so it follows its item, and goes stale (valid() == false) once it dies.
+struct ParticleHandle{
+    unsigned slot;
+    unsigned generation;
+};
+
+//fixed capacity dense array, O(1) add and remove
+//live items are always items[0 .. size()), so the solvers still see a plain
+//vector. removing moves the last item into the hole (swap and pop).
+//capacity is reserved up front, items never reallocate.
+template <typename T>
+struct ParticlePool{
+    vector<T> items;
+    vector<unsigned> slotOf;        //dense index -> slot
+    vector<unsigned> indexOf;       //slot -> dense index
+    vector<unsigned> generation;    //slot -> bumped whenever the slot is freed
+    vector<unsigned> freeSlots;
+    unsigned capacity;
+
+    ParticlePool(unsigned cap = 0){
+        init(cap);
+    }
+
+    void init(unsigned cap){
+        capacity = cap;
+        items.clear();
+        items.reserve(cap);
+        slotOf.clear();
+        slotOf.reserve(cap);
+        indexOf.assign(cap, 0);
+        generation.assign(cap, 0);
+        freeSlots.clear();
+        for (int s = cap - 1; s >= 0; --s){
+            freeSlots.push_back(s);
+        }
+    }
+
+    unsigned size() const {
+        return items.size();
+    }
+    bool full() const {
+        return freeSlots.empty();
+    }
+
+    //returns a stale handle when the pool is full
+    ParticleHandle add(const T& t){
+        ParticleHandle h;
+        if (full()){
+            h.slot = capacity;
+            h.generation = 0;
+            return h;
+        }
+        h.slot = freeSlots.back();
+        freeSlots.pop_back();
+        h.generation = generation[h.slot];
+        indexOf[h.slot] = items.size();
+        slotOf.push_back(h.slot);
+        items.push_back(t);
+        return h;
+    }
+
+    void remove(unsigned i){
+        unsigned last = items.size() - 1;
+        unsigned slot = slotOf[i];
+        if (i != last){
+            items[i] = items[last];
+            slotOf[i] = slotOf[last];
+            indexOf[slotOf[i]] = i;
+        }
+        items.pop_back();
+        slotOf.pop_back();
+        generation[slot] ++;
+        freeSlots.push_back(slot);
+    }
+
+    //walks backwards so whatever moves into a hole has already been checked
+    template <typename Dead>
+    unsigned removeIf(Dead dead){
+        unsigned removed = 0;
+        for (int i = items.size() - 1; i >= 0; --i){
+            if (dead(items[i])){
+                remove(i);
+                removed ++;
+            }
+        }
+        return removed;
+    }
+
+    void clear(){
+        while (!items.empty()) remove(items.size() - 1);
+    }
+
+    //reorders the live items, order.apply(v) must permute any vector the
+    //same way (see MortonOrder). handles follow their items, only dense
+    //indices change
+    template <typename Order>
+    void reorder(Order& order){
+        order.apply(items);
+        order.apply(slotOf);
+        for (unsigned i = 0; i < items.size(); ++i){
+            indexOf[slotOf[i]] = i;
+        }
+    }
+
+    bool valid(ParticleHandle h) const {
+        return h.slot < capacity && generation[h.slot] == h.generation;
+    }
+    //dense index of a live handle, size() for a stale one
+    unsigned index(ParticleHandle h) const {
+        return valid(h) ? indexOf[h.slot] : size();
+    }
+    T* get(ParticleHandle h){
+        return valid(h) ? &items[indexOf[h.slot]] : 0;
+    }
+    ParticleHandle handle(unsigned i) const {
+        ParticleHandle h;
+        h.slot = slotOf[i];
+        h.generation = generation[h.slot];
+        return h;
+    }
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef INCLUDE_PARTICLE_STORE_HPP
+#define INCLUDE_PARTICLE_STORE_HPP
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include "allocore/io/al_App.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+using namespace al;
+using namespace std;
+
+//structure-of-arrays copy of the particle state the force pass needs
+//a Particle is ~100 bytes, the inner loop wants 28 of them; here every
+//field is its own 32 byte aligned array so one cache line holds 8 x's,
+//and the all-pairs loop runs 8 (avx) or 4 (sse) partners at a time.
+//gather() before the force pass, scatter() the results back after.
+
+float* alignedFloats(unsigned n){
+    void* p = 0;
+    if (posix_memalign(&p, 32, n * sizeof(float)) != 0) return 0;
+    return (float*)p;
+}
+
+struct ParticleStore{
+    //read by the kernel
+    float *x, *y, *z;
+    float *vx, *vy, *vz;
+    float *mass;
+    //written by the kernel
+    float *ax, *ay, *az;
+    float *sx, *sy, *sz;    //spring force
+    unsigned count;         //live particles
+    unsigned padded;        //count rounded up to the simd width
+    unsigned capacity;
+    unsigned tile;          //partners per tile, 7 arrays * 512 * 4 bytes stays in L1
+
+    ParticleStore(){
+        x = y = z = vx = vy = vz = mass = 0;
+        ax = ay = az = sx = sy = sz = 0;
+        count = padded = capacity = 0;
+        tile = 512;
+    }
+    ~ParticleStore(){
+        release();
+    }
+    //owns raw arrays, keep it out of copies
+    ParticleStore(const ParticleStore&) = delete;
+    ParticleStore& operator=(const ParticleStore&) = delete;
+
+    void release(){
+        float** arrays[] = { &x, &y, &z, &vx, &vy, &vz, &mass, &ax, &ay, &az, &sx, &sy, &sz };
+        for (float** a : arrays){
+            free(*a);
+            *a = 0;
+        }
+        capacity = 0;
+    }
+
+    //held by the arrays, they are not allocated with new
+    size_t bytes() const {
+        return (size_t)13 * capacity * sizeof(float);
+    }
+
+    void resize(unsigned n){
+        count = n;
+        padded = (n + 7) & ~7u;
+        if (padded <= capacity) return;
+        release();
+        capacity = padded * 2;
+        float** arrays[] = { &x, &y, &z, &vx, &vy, &vz, &mass, &ax, &ay, &az, &sx, &sy, &sz };
+        for (float** a : arrays){
+            *a = alignedFloats(capacity);
+        }
+    }
+
+    //anything with .position, .velocity and .mass works as a body
+    template <typename Body>
+    void gather(const vector<Body>& bodies){
+        resize(bodies.size());
+        for (unsigned i = 0; i < count; ++i){
+            const Body& b = bodies[i];
+            x[i] = b.position.x; y[i] = b.position.y; z[i] = b.position.z;
+            vx[i] = b.velocity.x; vy[i] = b.velocity.y; vz[i] = b.velocity.z;
+            mass[i] = b.mass;
+        }
+        //padding: massless and far away, contributes nothing to anyone
+        for (unsigned i = count; i < padded; ++i){
+            x[i] = y[i] = z[i] = 1e9f + i;
+            vx[i] = vy[i] = vz[i] = 0;
+            mass[i] = 0;
+        }
+    }
+
+    //adds the kernel results onto acceleration and spring_force
+    template <typename Body>
+    void scatter(vector<Body>& bodies) const {
+        for (unsigned i = 0; i < count && i < bodies.size(); ++i){
+            bodies[i].acceleration += Vec3f(ax[i], ay[i], az[i]);
+            bodies[i].spring_force += Vec3f(sx[i], sy[i], sz[i]);
+        }
+    }
+
+    void clearResults(){
+        for (unsigned i = 0; i < padded; ++i){
+            ax[i] = ay[i] = az[i] = 0;
+            sx[i] = sy[i] = sz[i] = 0;
+        }
+    }
+
+    //gravity of j on i (G * m_j / d^2 toward j) and the hooke spring when
+    //0 < d < minDistance, for one i against partners [j0, j1)
+    void interactScalar(unsigned i, unsigned j0, unsigned j1, float G, float minDistance, float k, float b){
+        float pax = 0, pay = 0, paz = 0, psx = 0, psy = 0, psz = 0;
+        float min2 = minDistance * minDistance;
+        for (unsigned j = j0; j < j1; ++j){
+            float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+            float d2 = dx * dx + dy * dy + dz * dz;
+            if (d2 <= 0) continue;
+            float inv = G * mass[j] / (d2 * sqrtf(d2));
+            pax += dx * inv; pay += dy * inv; paz += dz * inv;
+            if (d2 < min2){
+                psx += -dx * k - (vx[i] - vx[j]) * b;
+                psy += -dy * k - (vy[i] - vy[j]) * b;
+                psz += -dz * k - (vz[i] - vz[j]) * b;
+            }
+        }
+        ax[i] += pax; ay[i] += pay; az[i] += paz;
+        sx[i] += psx; sy[i] += psy; sz[i] += psz;
+    }
+
+#if defined(__AVX__)
+    static float hsum(__m256 v){
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+    void interactSimd(unsigned i, unsigned j0, unsigned j1, float G, float minDistance, float k, float b){
+        __m256 xi = _mm256_set1_ps(x[i]), yi = _mm256_set1_ps(y[i]), zi = _mm256_set1_ps(z[i]);
+        __m256 vxi = _mm256_set1_ps(vx[i]), vyi = _mm256_set1_ps(vy[i]), vzi = _mm256_set1_ps(vz[i]);
+        __m256 g = _mm256_set1_ps(G), min2 = _mm256_set1_ps(minDistance * minDistance);
+        __m256 kk = _mm256_set1_ps(k), bb = _mm256_set1_ps(b), zero = _mm256_setzero_ps();
+        __m256 pax = zero, pay = zero, paz = zero, psx = zero, psy = zero, psz = zero;
+        for (unsigned j = j0; j < j1; j += 8){
+            __m256 dx = _mm256_sub_ps(_mm256_load_ps(x + j), xi);
+            __m256 dy = _mm256_sub_ps(_mm256_load_ps(y + j), yi);
+            __m256 dz = _mm256_sub_ps(_mm256_load_ps(z + j), zi);
+            __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            __m256 live = _mm256_cmp_ps(d2, zero, _CMP_GT_OQ);
+            __m256 d3 = _mm256_mul_ps(d2, _mm256_sqrt_ps(d2));
+            __m256 inv = _mm256_and_ps(live, _mm256_div_ps(_mm256_mul_ps(g, _mm256_load_ps(mass + j)), d3));
+            pax = _mm256_add_ps(pax, _mm256_mul_ps(dx, inv));
+            pay = _mm256_add_ps(pay, _mm256_mul_ps(dy, inv));
+            paz = _mm256_add_ps(paz, _mm256_mul_ps(dz, inv));
+            __m256 touch = _mm256_and_ps(live, _mm256_cmp_ps(d2, min2, _CMP_LT_OQ));
+            if (_mm256_movemask_ps(touch)){
+                __m256 rvx = _mm256_sub_ps(vxi, _mm256_load_ps(vx + j));
+                __m256 rvy = _mm256_sub_ps(vyi, _mm256_load_ps(vy + j));
+                __m256 rvz = _mm256_sub_ps(vzi, _mm256_load_ps(vz + j));
+                psx = _mm256_sub_ps(psx, _mm256_and_ps(touch, _mm256_add_ps(_mm256_mul_ps(dx, kk), _mm256_mul_ps(rvx, bb))));
+                psy = _mm256_sub_ps(psy, _mm256_and_ps(touch, _mm256_add_ps(_mm256_mul_ps(dy, kk), _mm256_mul_ps(rvy, bb))));
+                psz = _mm256_sub_ps(psz, _mm256_and_ps(touch, _mm256_add_ps(_mm256_mul_ps(dz, kk), _mm256_mul_ps(rvz, bb))));
+            }
+        }
+        ax[i] += hsum(pax); ay[i] += hsum(pay); az[i] += hsum(paz);
+        sx[i] += hsum(psx); sy[i] += hsum(psy); sz[i] += hsum(psz);
+    }
+#elif defined(__SSE__) || defined(_M_X64)
+    static float hsum(__m128 s){
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+    void interactSimd(unsigned i, unsigned j0, unsigned j1, float G, float minDistance, float k, float b){
+        __m128 xi = _mm_set1_ps(x[i]), yi = _mm_set1_ps(y[i]), zi = _mm_set1_ps(z[i]);
+        __m128 vxi = _mm_set1_ps(vx[i]), vyi = _mm_set1_ps(vy[i]), vzi = _mm_set1_ps(vz[i]);
+        __m128 g = _mm_set1_ps(G), min2 = _mm_set1_ps(minDistance * minDistance);
+        __m128 kk = _mm_set1_ps(k), bb = _mm_set1_ps(b), zero = _mm_setzero_ps();
+        __m128 pax = zero, pay = zero, paz = zero, psx = zero, psy = zero, psz = zero;
+        for (unsigned j = j0; j < j1; j += 4){
+            __m128 dx = _mm_sub_ps(_mm_load_ps(x + j), xi);
+            __m128 dy = _mm_sub_ps(_mm_load_ps(y + j), yi);
+            __m128 dz = _mm_sub_ps(_mm_load_ps(z + j), zi);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 live = _mm_cmpgt_ps(d2, zero);
+            __m128 d3 = _mm_mul_ps(d2, _mm_sqrt_ps(d2));
+            __m128 inv = _mm_and_ps(live, _mm_div_ps(_mm_mul_ps(g, _mm_load_ps(mass + j)), d3));
+            pax = _mm_add_ps(pax, _mm_mul_ps(dx, inv));
+            pay = _mm_add_ps(pay, _mm_mul_ps(dy, inv));
+            paz = _mm_add_ps(paz, _mm_mul_ps(dz, inv));
+            __m128 touch = _mm_and_ps(live, _mm_cmplt_ps(d2, min2));
+            if (_mm_movemask_ps(touch)){
+                __m128 rvx = _mm_sub_ps(vxi, _mm_load_ps(vx + j));
+                __m128 rvy = _mm_sub_ps(vyi, _mm_load_ps(vy + j));
+                __m128 rvz = _mm_sub_ps(vzi, _mm_load_ps(vz + j));
+                psx = _mm_sub_ps(psx, _mm_and_ps(touch, _mm_add_ps(_mm_mul_ps(dx, kk), _mm_mul_ps(rvx, bb))));
+                psy = _mm_sub_ps(psy, _mm_and_ps(touch, _mm_add_ps(_mm_mul_ps(dy, kk), _mm_mul_ps(rvy, bb))));
+                psz = _mm_sub_ps(psz, _mm_and_ps(touch, _mm_add_ps(_mm_mul_ps(dz, kk), _mm_mul_ps(rvz, bb))));
+            }
+        }
+        ax[i] += hsum(pax); ay[i] += hsum(pay); az[i] += hsum(paz);
+        sx[i] += hsum(psx); sy[i] += hsum(psy); sz[i] += hsum(psz);
+    }
+#else
+    void interactSimd(unsigned i, unsigned j0, unsigned j1, float G, float minDistance, float k, float b){
+        interactScalar(i, j0, j1, G, minDistance, k, b);
+    }
+#endif
+
+    //every i against every j, j in tiles so the partner arrays stay in cache
+    //while all i's stream past them
+    void allPairs(float G, float minDistance, float k, float b){
+        clearResults();
+        for (unsigned j0 = 0; j0 < padded; j0 += tile){
+            unsigned j1 = j0 + tile < padded ? j0 + tile : padded;
+            for (unsigned i = 0; i < count; ++i){
+                interactSimd(i, j0, j1, G, minDistance, k, b);
+            }
+        }
+    }
+};
+
+#endif
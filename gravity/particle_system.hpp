@@ -0,0 +1,432 @@
+#ifndef INCLUDE_PARTICLE_SYSTEM_HPP
+#define INCLUDE_PARTICLE_SYSTEM_HPP
+
+#include "allocore/io/al_App.hpp"
+#include "octree.hpp"
+#include "particle_store.hpp"
+#include "parallel_forces.hpp"
+#include "spatial_grid.hpp"
+#include "particle_pool.hpp"
+#include "control_channel.hpp"
+#include "particle_mesh.hpp"
+#include "morton_order.hpp"
+using namespace al;
+using namespace std;
+
+//particle simulation without the app, shared by simulator.cpp and benchmark.cpp
+
+// some of these must be carefully balanced; i spent some time turning them.
+// change them however you like, but make a note of these settings.
+unsigned particleCount = 50;     // try 2, 5, 50, and 5000 //500
+unsigned maxParticles = 9999;     // pool capacity, the size of the State arrays
+double maximumAcceleration = 30;  // prevents explosion, loss of particles //30
+double initialRadius = 50;        // initial condition //50
+double initialSpeed = 5;         // initial condition //50
+double gravityFactor = 1e6;       // see Gravitational Constant //1e6
+double timeStep = 0.0625;         // keys change this value for effect //0.0625
+double simulationRate = 60;       // fixed steps per second of wall clock, each one timeStep long
+double springRate = 16;           // springs used to be a velocity kick per 0.0625 step
+double scaleFactor = 0.1;         // resizes the entire scene //0.1
+double sphereRadius = 6;  // increase this to make collisions more frequent //3
+double lifeDecaySpeed = 0.0006; //life decay speed of each particle
+double boundary_radius = 120; //a spherical boundary with center at (0,0,0)
+Vec3f boundary_origin(0,0,0); //boundary center as (0,0,0)
+double spring_k = 1; //k constant best with 0.3 ~ 1
+double spring_b = 0.9; //damping coefficiency best with 0 ~ 1
+float theta = 0.5; //barnes-hut opening angle, smaller is more accurate
+unsigned sortInterval = 32; //steps between morton re-sorts of the particles, 0 never
+unsigned meshSize = 32; //particle-mesh nodes a side, power of two, bigger is more accurate
+unsigned maxMeshSize = 128; //the app's keys stop here, the padded 256^3 grid would take ~1.5 GB
+
+Mesh sphere;  // global prototype; leave this alone
+
+// helper function: makes a random vector
+Vec3f r() { return Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()); }
+
+int r_int(int init, int span){
+    int v = rand() % span + init;
+    return v;
+}
+
+struct Particle {
+  Vec3f position, velocity, acceleration;
+  float lifespan;
+  float mass;
+  float min_distance;
+  Vec3f force;
+  Vec3f spring_force;
+  Color c;
+  Particle() {
+    position = r() * initialRadius;
+    velocity =
+        // this will tend to spin stuff around the y axis
+        Vec3f(0, 1, 0).cross(position).normalize(initialSpeed);
+    c = HSV(rnd::uniform(), 0.7, 1);
+    lifespan = rnd::uniform() * 1.0;
+    mass = 1.0;
+    min_distance = sphereRadius * 2;
+  }
+  void applyForce(){
+      Vec3f f = acceleration / mass;
+      acceleration += f;
+      if (acceleration.mag() > maximumAcceleration){
+        acceleration.normalize(maximumAcceleration);
+      }
+  }
+  
+  bool operator == (const Particle& p) const {
+      if (position == p.position && lifespan == p.lifespan){
+        return true;
+      } else {
+          return false;
+      }
+  }
+  bool operator != (const Particle& p) const {
+      if (position != p.position || lifespan != p.lifespan){
+        return true;
+      } else {
+          return false;
+      }
+  }
+
+  //leapfrog (velocity verlet): kick(h / 2), drift(h), new forces, kick(h / 2)
+  void kick(double h){
+      velocity += acceleration * h;
+      velocity += spring_force * springRate * fabs(h); //collision spring effect, damps either way in time
+  }
+  void drift(double h){
+      position += velocity * h;
+      lifespan -= lifeDecaySpeed;
+  }
+  void collision_detect(const Particle& other){
+        gravity(other);
+        spring(other);
+  }
+  void gravity(const Particle& other){
+        Vec3f difference = (other.position - position);
+        double d = difference.mag(); //unit vector that points to the target
+        //gravitational force     // F = ma where m=1
+        force = difference / (d * d * d) * gravityFactor * other.mass;
+        acceleration += force;
+  }
+  void spring(const Particle& other){
+        Vec3f difference = (other.position - position);
+        double d = difference.mag();
+        //spring force calculation with hooke's law
+        if (d > 0 && d < min_distance){
+            Vec3f v = velocity - other.velocity; //relative velocity
+            spring_force += -difference * spring_k - v * spring_b;
+        }
+  }
+  void boundary_detect(){
+      Vec3f d = position - boundary_origin;
+      if (d > boundary_radius) {
+          velocity *= -1;
+      }
+  }
+  void draw(Graphics& g) {
+    g.pushMatrix();
+    g.translate(position);
+    g.color(c);
+    g.draw(sphere);
+    g.popMatrix();
+  }
+  //this particle's share of ParticleSystem::sp_force_value()
+  float springLevel() const {
+      Vec3f sf = spring_force;
+      Vec3f sfn = sf.normalize();
+      return sf.mag() + sfn.mag() * 0.3;
+  }
+  bool isDead(){
+      if (lifespan < 0.0){
+          return true;
+      } else {
+          return false;
+      }
+  }
+};
+
+//force solvers, switch with key 't'
+enum ForceMode {
+    FORCE_PAIRWISE,   //exact O(N^2), the reference
+    FORCE_BARNES_HUT, //octree, O(N log N)
+    FORCE_SIMD,       //exact O(N^2), structure-of-arrays + simd tiles
+    FORCE_PARALLEL,   //exact O(N^2), triangle tiles over all cores
+    FORCE_PM,         //particle-mesh fft, O(N + M log M), softened below a grid cell
+    FORCE_MODES
+};
+const char* forceModeName[] = { "pairwise", "barnes-hut", "simd", "parallel", "pm" };
+
+struct ParticleSystem {
+    ParticlePool<Particle> pool;
+    vector<Particle>& particles; //live particles, owned by the pool; add and remove through it
+    Vec3f origin;
+    int init_number;
+    int forceMode;
+    Octree tree;
+    ParticleStore store;
+    ParallelForces parallel;
+    SpatialGrid grid;
+    ParticleMesh mesh;
+    MortonOrder morton;
+    unsigned stepsSinceSort;
+    double sortMs; //wall time of the last re-sort
+    bool gridSprings; //springs from the grid broad phase, not inside the gravity solver
+    double forceMs; //wall time of the last force pass
+    AudioParams params; //reduced during the force pass
+    ControlChannel<AudioParams> audioChannel; //params of the last step, for the audio thread
+
+    ParticleSystem() : pool(maxParticles), particles(pool.items) {
+        origin = Vec3f(0,0,0);
+        init_number = 10;
+        for (int i = 0; i < init_number; ++i){
+            addParticle();
+        }
+        forceMode = FORCE_PAIRWISE;
+        gridSprings = true;
+        forceMs = 0;
+        stepsSinceSort = 0;
+        sortMs = 0;
+        parallel.threads(thread::hardware_concurrency());
+    }
+    virtual ParticleHandle addParticle(){
+        Particle p;
+        //p.position = origin; //all start from one origin
+        return pool.add(p);
+    }
+    //lifecycle, O(1) per death
+    void reap(){
+        pool.removeIf([](Particle& p){ return p.isDead(); });
+    }
+    void applyForce(){
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        //forces are summed over all sources, then applied once
+        for (Particle& p : particles){
+            p.acceleration.zero();
+            p.spring_force.zero();
+        }
+        if (forceMode == FORCE_BARNES_HUT){
+            applyForceTree();
+        } else if (forceMode == FORCE_SIMD){
+            applyForceSimd();
+        } else if (forceMode == FORCE_PARALLEL){
+            applyForceParallel();
+        } else if (forceMode == FORCE_PM){
+            applyForceMesh();
+        } else {
+            applyForcePairwise();
+        }
+        //the mesh has no short range, its springs always come from the grid
+        if (gridSprings || forceMode == FORCE_PM){
+            applySprings();
+        }
+        //the sonification metrics come for free in the last pass
+        double springSum = 0;
+        double velocitySum = 0;
+        for (Particle& p : particles){
+            p.applyForce();
+            springSum += p.springLevel();
+            velocitySum += p.velocity.mag();
+        }
+        params.sp_force_value = springSum;
+        params.average_velocity_mag = particles.empty() ? 0 : velocitySum / particles.size();
+        forceMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    }
+    void applyForcePairwise(){
+        for (unsigned i = 0; i < particles.size(); ++i){
+            for (unsigned j = 1 + i; j < particles.size(); ++j) {
+                Particle& a = particles[i];
+                Particle& b = particles[j];
+                if (a != b){
+                    if (gridSprings){
+                        a.gravity(b);
+                        b.gravity(a);
+                    } else {
+                        a.collision_detect(b);
+                        b.collision_detect(a);
+                    }
+                }
+            }
+        }
+    }
+    void applyForceTree(){
+        tree.theta = theta;
+        tree.build(particles);
+        for (unsigned i = 0; i < particles.size(); ++i){
+            Particle& a = particles[i];
+            if (gridSprings){
+                a.acceleration += tree.gravity(i, gravityFactor, 0, [](int){});
+            } else {
+                //springs only reach as far as min_distance, the tree opens those cells for us
+                a.acceleration += tree.gravity(i, gravityFactor, a.min_distance, [&](int j){
+                    a.spring(particles[j]);
+                });
+            }
+        }
+    }
+    //hooke springs between overlapping particles, O(N) through the grid
+    //cells are min_distance wide, so every overlap is in the 27 cells around
+    void applySprings(){
+        grid.build(particles, sphereRadius * 2);
+        for (unsigned i = 0; i < particles.size(); ++i){
+            Particle& a = particles[i];
+            grid.neighbours(a.position, [&](unsigned j){
+                if (j != i && a != particles[j]) a.spring(particles[j]);
+            });
+        }
+    }
+    float springDistance(){
+        return gridSprings ? 0 : sphereRadius * 2;
+    }
+    void applyForceSimd(){
+        store.gather(particles);
+        store.allPairs(gravityFactor, springDistance(), spring_k, spring_b);
+        store.scatter(particles);
+    }
+    void applyForceParallel(){
+        store.gather(particles);
+        parallel.run(store, gravityFactor, springDistance(), spring_k, spring_b);
+        store.scatter(particles);
+    }
+    //the grid is the cube around the particles' bounding box, wherever the
+    //boundary is (a benchmark can push it out of reach)
+    void applyForceMesh(){
+        if (particles.empty()) return;
+        Vec3f lo = particles[0].position;
+        Vec3f hi = lo;
+        for (Particle& p : particles){
+            for (unsigned a = 0; a < 3; ++a){
+                if (p.position[a] < lo[a]) lo[a] = p.position[a];
+                if (p.position[a] > hi[a]) hi[a] = p.position[a];
+            }
+        }
+        float halfWidth = sphereRadius; //a lone particle still gets a grid
+        for (unsigned a = 0; a < 3; ++a){
+            if ((hi[a] - lo[a]) * 0.5f > halfWidth) halfWidth = (hi[a] - lo[a]) * 0.5f;
+        }
+        mesh.resize(meshSize, parallel.pool);
+        mesh.solve(particles, gravityFactor, (lo + hi) * 0.5f, halfWidth * 1.01, parallel.pool);
+        for (Particle& p : particles){
+            p.acceleration += mesh.acceleration(p.position);
+        }
+    }
+    Vec3f exactGravity(unsigned i){
+        Vec3f exact(0,0,0);
+        for (unsigned j = 0; j < particles.size(); ++j){
+            if (j == i) continue;
+            Vec3f difference = particles[j].position - particles[i].position;
+            double d = difference.mag();
+            if (d > 0) exact += difference / (d * d * d) * gravityFactor * particles[j].mass;
+        }
+        return exact;
+    }
+    //rms relative error of the tree gravity against the exact sum
+    double treeError(){
+        if (particles.size() < 2) return 0;
+        tree.theta = theta;
+        tree.build(particles);
+        double sum = 0;
+        for (unsigned i = 0; i < particles.size(); ++i){
+            Vec3f exact = exactGravity(i);
+            Vec3f approx = tree.gravity(i, gravityFactor, 0, [](int){});
+            double e = (approx - exact).mag() / exact.mag();
+            sum += e * e;
+        }
+        return sqrt(sum / particles.size());
+    }
+    //same for the mesh, over at most samples particles spread through the list
+    double meshError(unsigned samples = 1000){
+        if (particles.size() < 2) return 0;
+        for (Particle& p : particles) p.acceleration.zero();
+        applyForceMesh();
+        unsigned stride = particles.size() / samples + 1;
+        double sum = 0;
+        unsigned count = 0;
+        for (unsigned i = 0; i < particles.size(); i += stride){
+            Vec3f exact = exactGravity(i);
+            double e = (particles[i].acceleration - exact).mag() / exact.mag();
+            sum += e * e;
+            count ++;
+        }
+        return sqrt(sum / count);
+    }
+    void boundary_detect(){
+        for (Particle& p : particles) {
+            p.boundary_detect();
+        }
+    }
+    //z-order the particles so neighbours in space are neighbours in memory
+    //handles (and so anything holding one) stay valid; the State is filled
+    //in dense order every frame, so it just follows along
+    void sortParticles(){
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        morton.sort(particles, &parallel.pool);
+        pool.reorder(morton);
+        stepsSinceSort = 0;
+        sortMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    }
+    //one fixed step of length h, acceleration is kept from the step before
+    void step(double h){
+        if (sortInterval > 0 && ++stepsSinceSort >= sortInterval){
+            sortParticles();
+        }
+        for (Particle& p : particles) {
+            p.kick(h * 0.5);
+            p.drift(h);
+        }
+        applyForce();
+        for (Particle& p : particles) {
+            p.kick(h * 0.5);
+        }
+        boundary_detect();
+        audioChannel.publish(params);
+    }
+    virtual void draw(Graphics& g){
+        for (int i = particles.size() - 1; i >= 0; i--){
+            Particle& p = particles[i];
+            p.draw(g);
+        }
+    }
+    //total energy, exact O(N^2); Particle::applyForce adds a / m on top of a,
+    //so the potential that matches the motion is -2 G m_i m_j / d
+    double energy(){
+        double kinetic = 0;
+        double potential = 0;
+        for (unsigned i = 0; i < particles.size(); ++i){
+            kinetic += 0.5 * particles[i].mass * particles[i].velocity.magSqr();
+            for (unsigned j = i + 1; j < particles.size(); ++j){
+                double d = (particles[j].position - particles[i].position).mag();
+                if (d > 0) potential -= 2 * gravityFactor * particles[i].mass * particles[j].mass / d;
+            }
+        }
+        return kinetic + potential;
+    }
+    Vec3d momentum(){
+        Vec3d sum(0,0,0);
+        for (Particle& p : particles){
+            sum += Vec3d(p.velocity) * p.mass;
+        }
+        return sum;
+    }
+    double sp_force_value(){
+        double sp_force_value = 0;
+        for (Particle& p : particles){
+            sp_force_value += p.springLevel();
+        }
+        return sp_force_value;
+    }
+    double average_velocity_mag(){
+        int count = 0;
+        double v = 0;
+        for (Particle& p : particles){
+            v += p.velocity.mag();
+            count ++;
+        }
+        if (count > 0){
+            v /= count;
+        }
+        return v;
+    }
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "allocore/io/al_App.hpp"
 #include "Cuttlebone/Cuttlebone.hpp"
 #include "common.hpp"
+#include "particle_system.hpp"
 using namespace al;
 using namespace std;
 
@@ -9,32 +10,6 @@ using namespace std;
 //mengyuchen@ucsb.edu
 //licensed under the MIT license
 
-// some of these must be carefully balanced; i spent some time turning them.
-// change them however you like, but make a note of these settings.
-unsigned particleCount = 50;     // try 2, 5, 50, and 5000 //500
-double maximumAcceleration = 30;  // prevents explosion, loss of particles //30
-double initialRadius = 50;        // initial condition //50
-double initialSpeed = 5;         // initial condition //50
-double gravityFactor = 1e6;       // see Gravitational Constant //1e6
-double timeStep = 0.0625;         // keys change this value for effect //0.0625
-double scaleFactor = 0.1;         // resizes the entire scene //0.1
-double sphereRadius = 6;  // increase this to make collisions more frequent //3
-double lifeDecaySpeed = 0.0006; //life decay speed of each particle
-double boundary_radius = 120; //a spherical boundary with center at (0,0,0)
-Vec3f boundary_origin(0,0,0); //boundary center as (0,0,0)
-double spring_k = 1; //k constant best with 0.3 ~ 1
-double spring_b = 0.9; //damping coefficiency best with 0 ~ 1
-
-Mesh sphere;  // global prototype; leave this alone
-
-// helper function: makes a random vector
-Vec3f r() { return Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()); }
-
-int r_int(int init, int span){
-    int v = rand() % span + init;
-    return v;
-}
-
 struct Phasor{  //saw / ramp
     float phase = 0, increment = 0.001;
     float frequency(float hz, float sampleRate){
@@ -71,163 +46,6 @@ struct Reverb{
     }
 };
 
-struct Particle {
-  Vec3f position, velocity, acceleration;
-  float lifespan;
-  float mass;
-  float min_distance;
-  Vec3f force;
-  Vec3f spring_force;
-  Color c;
-  Particle() {
-    position = r() * initialRadius;
-    velocity =
-        // this will tend to spin stuff around the y axis
-        Vec3f(0, 1, 0).cross(position).normalize(initialSpeed);
-    c = HSV(rnd::uniform(), 0.7, 1);
-    lifespan = rnd::uniform() * 1.0;
-    mass = 1.0;
-    min_distance = sphereRadius * 2;
-  }
-  void applyForce(){
-      Vec3f f = acceleration / mass;
-      acceleration += f;
-      if (acceleration.mag() > maximumAcceleration){
-        acceleration.normalize(maximumAcceleration);
-      }
-      velocity += spring_force; //collision spring effect
-  }
-  
-  bool operator == (const Particle& p) const {
-      if (position == p.position && lifespan == p.lifespan){
-        return true;
-      } else {
-          return false;
-      }
-  }
-  bool operator != (const Particle& p) const {
-      if (position != p.position || lifespan != p.lifespan){
-        return true;
-      } else {
-          return false;
-      }
-  }
-
-  void update(){
-      velocity += acceleration * timeStep;
-      position += velocity * timeStep;
-      acceleration.zero(); //zero acceleration
-      lifespan -= lifeDecaySpeed;
-  }
-  void collision_detect(const Particle& other){
-        Vec3f difference = (other.position - position);
-        double d = difference.mag(); //unit vector that points to the target
-        //gravitational force     // F = ma where m=1
-        force = difference / (d * d * d) * gravityFactor;
-        acceleration = force;
-
-        //spring force calculation with hooke's law
-        if (d > 0 && d < min_distance){
-            Vec3f v = velocity - other.velocity; //relative velocity
-            spring_force = -difference * spring_k - v * spring_b;
-        } else {
-            spring_force.set(0,0,0);
-        }
-  }   
-  void boundary_detect(){
-      Vec3f d = position - boundary_origin;
-      if (d > boundary_radius) {
-          velocity *= -1;
-      }
-  }
-  void draw(Graphics& g) {
-    g.pushMatrix();
-    g.translate(position);
-    g.color(c);
-    g.draw(sphere);
-    g.popMatrix();
-  }
-  bool isDead(){
-      if (lifespan < 0.0){
-          return true;
-      } else {
-          return false;
-      }
-  }
-};
-
-struct ParticleSystem {
-    vector<Particle> particles;
-    Vec3f origin;
-    int init_number;
-
-    ParticleSystem(){
-        origin = Vec3f(0,0,0);
-        init_number = 10;
-        particles.resize(init_number);
-    }
-    virtual void addParticle(){
-        Particle p;
-        //p.position = origin; //all start from one origin
-        particles.push_back(p);
-    }
-    void applyForce(){
-        for (unsigned i = 0; i < particles.size(); ++i){
-            for (unsigned j = 1 + i; j < particles.size(); ++j) {
-                Particle& a = particles[i];
-                Particle& b = particles[j];
-                if (a != b){
-                    a.collision_detect(b);
-                    b.collision_detect(a);
-                    a.applyForce();
-                    b.applyForce();
-                }
-            }
-        }
-    }
-    void boundary_detect(){
-        for (Particle& p : particles) {
-            p.boundary_detect();
-        }
-    }
-    void update(){
-         for (Particle& p : particles) {
-            p.update();
-        }
-    }
-    virtual void draw(Graphics& g){
-        for (int i = particles.size() - 1; i >= 0; i--){
-            Particle& p = particles[i];
-            p.draw(g);
-            if (p.isDead()){
-                particles.erase(particles.begin() + i);
-            }
-        }
-    }
-    double sp_force_value(){
-        double sp_force_value = 0;
-        for (Particle& p : particles){
-            Vec3f sf = p.spring_force;
-            Vec3f sfn = sf.normalize();
-            //sf.normalize();
-            sp_force_value += sf.mag() + sfn.mag() * 0.3;
-        }
-        return sp_force_value;
-    }
-    double average_velocity_mag(){
-        int count = 0;
-        double v = 0;
-        for (Particle& p : particles){
-            v += p.velocity.mag();
-            count ++;
-        }
-        if (count > 0){
-            v /= count;
-        }
-        return v;
-    }
-};
-
 struct MyApp : App {
   Material material;
   Light light;
@@ -236,10 +54,16 @@ struct MyApp : App {
   ParticleSystem ps;
   float t = 0;
   float generator_speed = 1.5;
+  bool reportTiming = false;
+  double timingSum = 0;
+  int timingSteps = 0;
+  double accumulator = 0; //wall clock time not simulated yet
+  int maxSubsteps = 8;    //past this we can't keep up, drop the backlog
 
   //audio params
   Phasor phasor;
   Sawtooch saw;
+  AudioParams audioFrom, audioTo; //ramp across one block
 
   //cuttlebone
   State state;
@@ -276,6 +100,18 @@ struct MyApp : App {
     cout << "press 0 : reset all to default" << endl;
     cout << "press - : slower autogeneration" << endl;
     cout << "press = : faster autogeneration" << endl;
+    cout << "press t : next gravity solver (pairwise, barnes-hut, simd, parallel, pm)" << endl;
+    cout << "press [ : barnes-hut more accurate" << endl;
+    cout << "press ] : barnes-hut faster" << endl;
+    cout << "press { : coarser particle-mesh grid" << endl;
+    cout << "press } : finer particle-mesh grid" << endl;
+    cout << "press e : print barnes-hut / particle-mesh error" << endl;
+    cout << "press , : fewer force threads" << endl;
+    cout << "press . : more force threads" << endl;
+    cout << "press p : report force timing on/off" << endl;
+    cout << "press g : springs from grid / inside gravity solver" << endl;
+    cout << "press o : bigger steps, fewer per second" << endl;
+    cout << "press i : smaller steps, more per second" << endl;
   }
 
   virtual void onAnimate(double dt) {
@@ -292,10 +128,36 @@ struct MyApp : App {
             ps.addParticle();
         }
     }
-    //particle system update
-    ps.update();
-    ps.applyForce();
-    ps.boundary_detect();
+    //particle system update, fixed steps against the wall clock
+    accumulator += dt;
+    int substeps = 0;
+    while (accumulator >= 1.0 / simulationRate && substeps < maxSubsteps){
+        ps.step(timeStep);
+        accumulator -= 1.0 / simulationRate;
+        substeps ++;
+    }
+    if (substeps == maxSubsteps) accumulator = 0;
+    ps.reap();
+
+    //per step timing, averaged over a second or so
+    if (reportTiming){
+        timingSum += ps.forceMs;
+        timingSteps ++;
+        if (timingSteps == 60){
+            cout << forceModeName[ps.forceMode] << " " << ps.particles.size() << " particles, "
+                 << ps.parallel.threads() << " threads: " << timingSum / timingSteps << " ms/step";
+            if (ps.forceMode == FORCE_PARALLEL){
+                cout << " (reduce " << ps.parallel.reduceMs << " ms)";
+            }
+            if (ps.forceMode == FORCE_PM){
+                cout << " (" << ps.mesh.size << "^3 mesh, deposit " << ps.mesh.depositMs
+                     << " ms, fft " << ps.mesh.fftMs << " ms, gradient " << ps.mesh.gradientMs << " ms)";
+            }
+            cout << endl;
+            timingSum = 0;
+            timingSteps = 0;
+        }
+    }
 
     //generator speed control
     if (t < 1) {
@@ -310,8 +172,8 @@ struct MyApp : App {
         state.p_pos[i] = ps.particles[i].position;
         state.p_colors[i] = ps.particles[i].c;
     }
-    state.sp_force_value = ps.sp_force_value();
-    state.average_velocity_mag = ps.average_velocity_mag();
+    state.sp_force_value = ps.params.sp_force_value;
+    state.average_velocity_mag = ps.params.average_velocity_mag;
   }
 
   virtual void onDraw(Graphics& g) {
@@ -323,9 +185,17 @@ struct MyApp : App {
 
   virtual void onSound(AudioIOData& io) {
      //io(); // means ready yourself for the next sample set
+    //simulation metrics once per block, ramped per sample
+    audioFrom = audioTo;
+    ps.audioChannel.read(audioTo);
+    float frames = io.framesPerBuffer();
+    float frame = 0;
     while (io()) {
-        phasor.frequency(20 * ps.sp_force_value(), 44100);
-        saw.frequency(ps.average_velocity_mag() * 5,44100);
+        float ramp = ++frame / frames;
+        float sp_force_value = audioFrom.sp_force_value + (audioTo.sp_force_value - audioFrom.sp_force_value) * ramp;
+        float average_velocity_mag = audioFrom.average_velocity_mag + (audioTo.average_velocity_mag - audioFrom.average_velocity_mag) * ramp;
+        phasor.frequency(20 * sp_force_value, 44100);
+        saw.frequency(average_velocity_mag * 5,44100);
         float sample = phasor() * 0.3 + saw() * 0.08;  
         
         //io.out(0) = sample;
@@ -339,6 +209,65 @@ struct MyApp : App {
 
   void onKeyDown(const ViewpointWindow&, const Keyboard& k) {
     switch (k.key()) {
+      case 't':
+        ps.forceMode = (ps.forceMode + 1) % FORCE_MODES;
+        cout << forceModeName[ps.forceMode] << endl;
+        break;
+      case '[':
+        if (theta > 0.1) theta -= 0.1;
+        cout << "theta = " << theta << endl;
+        break;
+      case ']':
+        if (theta < 1.5) theta += 0.1;
+        cout << "theta = " << theta << endl;
+        break;
+      case ',':
+        if (ps.parallel.threads() > 1) ps.parallel.threads(ps.parallel.threads() / 2);
+        cout << ps.parallel.threads() << " threads" << endl;
+        break;
+      case '.':
+        if (ps.parallel.threads() < 64) ps.parallel.threads(ps.parallel.threads() * 2);
+        cout << ps.parallel.threads() << " threads" << endl;
+        break;
+      case 'o':
+        //same simulated speed, half the force evaluations
+        if (simulationRate > 7.5) {
+            simulationRate /= 2;
+            timeStep *= 2;
+        }
+        cout << simulationRate << " steps/s of " << timeStep << endl;
+        break;
+      case 'i':
+        if (simulationRate < 480) {
+            simulationRate *= 2;
+            timeStep /= 2;
+        }
+        cout << simulationRate << " steps/s of " << timeStep << endl;
+        break;
+      case 'g':
+        ps.gridSprings = !ps.gridSprings;
+        cout << (ps.gridSprings ? "grid springs" : "springs in gravity solver") << endl;
+        break;
+      case 'p':
+        reportTiming = !reportTiming;
+        timingSum = 0;
+        timingSteps = 0;
+        break;
+      case 'e':
+        if (ps.forceMode == FORCE_PM){
+            cout << "particle-mesh rms error = " << ps.meshError() << " (" << meshSize << "^3)" << endl;
+        } else {
+            cout << "barnes-hut rms error = " << ps.treeError() << " (theta " << theta << ")" << endl;
+        }
+        break;
+      case '{':
+        if (meshSize > 8) meshSize /= 2;
+        cout << "mesh " << meshSize << "^3" << endl;
+        break;
+      case '}':
+        if (meshSize < maxMeshSize) meshSize *= 2;
+        cout << "mesh " << meshSize << "^3" << endl;
+        break;
       default:
       case '1':
         // reverse time
@@ -385,6 +314,7 @@ struct MyApp : App {
         break;
       case '0':
         timeStep = 0.0625; 
+        simulationRate = 60;
         simulate = true;
         generator = true;
         lifeDecaySpeed = 0.001;
@@ -0,0 +1,105 @@
+#ifndef INCLUDE_SPATIAL_GRID_HPP
+#define INCLUDE_SPATIAL_GRID_HPP
+
+#include <vector>
+#include <cmath>
+#include "allocore/io/al_App.hpp"
+
+using namespace al;
+using namespace std;
+
+//uniform grid broad phase, hashed so it needs no bounds
+//with cellSize >= the interaction radius everything within reach of a
+//particle sits in its own cell or one of the 26 around it. built with a
+//counting sort, so build and query are both O(N) for the whole system.
+//hash collisions only add candidates; callers still check the distance.
+
+struct SpatialGrid{
+    float cellSize;
+    unsigned tableSize;         //power of two, ~2 buckets per body
+    vector<unsigned> cellStart; //bucket b owns sorted[cellStart[b] .. cellStart[b + 1])
+    vector<unsigned> sorted;    //body indices grouped by bucket
+    vector<unsigned> bucketOf;
+    vector<unsigned> scratch;   //write cursors while building
+
+    SpatialGrid(){
+        cellSize = 1;
+        tableSize = 0;
+    }
+
+    int cell(float v) const {
+        return (int)floorf(v / cellSize);
+    }
+    unsigned hash(int ix, int iy, int iz) const {
+        return ((unsigned)ix * 73856093u ^ (unsigned)iy * 19349663u ^ (unsigned)iz * 83492791u) & (tableSize - 1);
+    }
+
+    //anything with .position works as a body
+    template <typename Body>
+    void build(const vector<Body>& bodies, float size){
+        build(bodies.size(), [&](unsigned i) -> const Vec3f& { return bodies[i].position; }, size);
+    }
+
+    //position(i) gives body i, for bodies that keep it somewhere else
+    template <typename Position>
+    void build(unsigned n, Position position, float size){
+        cellSize = size;
+        tableSize = 64;
+        while (tableSize < n * 2) tableSize *= 2;
+        cellStart.assign(tableSize + 1, 0);
+        bucketOf.resize(n);
+        sorted.resize(n);
+        for (unsigned i = 0; i < n; ++i){
+            const Vec3f& p = position(i);
+            bucketOf[i] = hash(cell(p.x), cell(p.y), cell(p.z));
+            cellStart[bucketOf[i] + 1] ++;
+        }
+        for (unsigned b = 0; b < tableSize; ++b){
+            cellStart[b + 1] += cellStart[b];
+        }
+        vector<unsigned>& fill = scratch;
+        fill.assign(cellStart.begin(), cellStart.end() - 1);
+        for (unsigned i = 0; i < n; ++i){
+            sorted[fill[bucketOf[i]] ++] = i;
+        }
+    }
+
+    //calls visit(j) for every body in the 27 cells around p
+    template <typename Visit>
+    void neighbours(const Vec3f& p, Visit visit) const {
+        cells(p, [&](unsigned begin, unsigned end){
+            for (unsigned k = begin; k < end; ++k){
+                visit(sorted[k]);
+            }
+        });
+    }
+
+    //calls visit(begin, end) for the range of sorted[] in each of the 27
+    //cells around p, for callers that keep their data in sorted order
+    template <typename Visit>
+    void cells(const Vec3f& p, Visit visit) const {
+        if (tableSize == 0) return;
+        int cx = cell(p.x), cy = cell(p.y), cz = cell(p.z);
+        unsigned seen[27];
+        int numSeen = 0;
+        for (int dz = -1; dz <= 1; ++dz){
+            for (int dy = -1; dy <= 1; ++dy){
+                for (int dx = -1; dx <= 1; ++dx){
+                    unsigned b = hash(cx + dx, cy + dy, cz + dz);
+                    //two cells landing in one bucket must not be walked twice
+                    bool repeated = false;
+                    for (int s = 0; s < numSeen; ++s){
+                        if (seen[s] == b) repeated = true;
+                    }
+                    if (repeated) continue;
+                    seen[numSeen++] = b;
+                    if (cellStart[b] < cellStart[b + 1]){
+                        visit(cellStart[b], cellStart[b + 1]);
+                    }
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef INCLUDE_THREAD_POOL_HPP
+#define INCLUDE_THREAD_POOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+//fixed set of worker threads that all run the same job once per call
+//run(job) calls job(t) for t = 0..size()-1 and returns when all are done.
+//the calling thread works as t = 0, so a pool of 1 spawns nothing.
+//threads are spawned once; spawning per step costs more than a small step.
+
+struct ThreadPool{
+    vector<thread> workers;
+    mutex m;
+    condition_variable wake;
+    condition_variable done;
+    function<void(unsigned)> job;
+    unsigned generation;
+    unsigned pending;
+    bool quit;
+
+    ThreadPool(){
+        generation = 0;
+        pending = 0;
+        quit = false;
+    }
+    ~ThreadPool(){
+        stop();
+    }
+
+    unsigned size() const {
+        return workers.size() + 1;
+    }
+
+    void resize(unsigned n){
+        if (n < 1) n = 1;
+        if (n == size()) return;
+        stop();
+        quit = false;
+        unsigned seen = generation;
+        for (unsigned t = 1; t < n; ++t){
+            workers.push_back(thread([this, t, seen](){ loop(t, seen); }));
+        }
+    }
+
+    void stop(){
+        {
+            lock_guard<mutex> lock(m);
+            quit = true;
+        }
+        wake.notify_all();
+        for (thread& w : workers) w.join();
+        workers.clear();
+    }
+
+    void run(function<void(unsigned)> f){
+        {
+            lock_guard<mutex> lock(m);
+            job = f;
+            pending = workers.size();
+            generation ++;
+        }
+        wake.notify_all();
+        f(0);
+        unique_lock<mutex> lock(m);
+        done.wait(lock, [this](){ return pending == 0; });
+    }
+
+    void loop(unsigned t, unsigned seen){
+        while (true){
+            function<void(unsigned)> f;
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait(lock, [&](){ return quit || generation != seen; });
+                if (quit) return;
+                seen = generation;
+                f = job;
+            }
+            f(t);
+            {
+                lock_guard<mutex> lock(m);
+                pending --;
+            }
+            done.notify_one();
+        }
+    }
+};
+
+#endif